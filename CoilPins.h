@@ -0,0 +1,212 @@
+// Ways of driving the four coil pins of a ScaraStepper, picked with the template argument of BasicScaraStepper
+// A coil state is one nibble in the same order as the comments in Step(): a = 8, b = 4, c = 2, d = 1.
+//   DigitalCoils  four digitalWrite calls, each one looks up the pin's port and mask again (the original code)
+//   PortCoils     port register and masks worked out once in the constructor, then one write per port used
+//                 (AVR: read-modify-write with interrupts off, Teensy: the atomic set and clear registers)
+//   FixedCoils    pins as template arguments, so on the ATmega328P (Uno/Nano) the ports and masks are constants
+//                 and a step compiles down to a couple of in/and/or/out instructions. Anywhere else it is PortCoils.
+// All four coils of a port change in the same write, so they switch together instead of one after another.
+// Pwm is for the microstep tables (CoilTables.h) and is analogWrite for all of them, there is no faster way to set a
+// duty cycle that works on every board.
+// tools/BenchCoilWrites.cpp compares them on the host.
+#pragma once
+#include <stdint.h>
+#include "Hal.h"
+
+// Drives one coil, the sign of duty (-255 to 255) picks which of its two pins gets the PWM
+inline void CoilPwm(int pin_plus, int pin_minus, int16_t duty) {
+  analogWrite(pin_plus, duty > 0 ? duty : 0);
+  analogWrite(pin_minus, duty < 0 ? -duty : 0);
+}
+
+#if defined(TEENSYDUINO)
+typedef uint32_t CoilRegister;
+#define COIL_PORT_IO
+#elif defined(__AVR__) || defined(HOST_ARDUINO)
+typedef uint8_t CoilRegister;
+#define COIL_PORT_IO
+#endif
+
+class DigitalCoils {
+  private:
+  int pin_a, pin_b, pin_c, pin_d;
+
+  public:
+  DigitalCoils(int pin_a, int pin_b, int pin_c, int pin_d) {
+    this->pin_a = pin_a;
+    this->pin_b = pin_b;
+    this->pin_c = pin_c;
+    this->pin_d = pin_d;
+    pinMode(this->pin_a, OUTPUT);
+    pinMode(this->pin_b, OUTPUT);
+    pinMode(this->pin_c, OUTPUT);
+    pinMode(this->pin_d, OUTPUT);
+  }
+
+  void Write(uint8_t state) {
+    digitalWrite(pin_a, state & 8 ? HIGH : LOW);
+    digitalWrite(pin_b, state & 4 ? HIGH : LOW);
+    digitalWrite(pin_c, state & 2 ? HIGH : LOW);
+    digitalWrite(pin_d, state & 1 ? HIGH : LOW);
+  }
+
+  void Pwm(int16_t ab, int16_t cd) {
+    CoilPwm(pin_a, pin_b, ab);
+    CoilPwm(pin_c, pin_d, cd);
+  }
+};
+
+#if defined(COIL_PORT_IO)
+
+class PortCoils {
+  private:
+  // One entry per distinct port, mask_a..d are 0 for pins that live on another port
+  struct Port {
+    volatile CoilRegister* out;  // on the Teensy only used to tell ports apart
+#if defined(TEENSYDUINO)
+    volatile CoilRegister* set;
+    volatile CoilRegister* clear;
+#endif
+    CoilRegister mask_a, mask_b, mask_c, mask_d, all;
+  };
+  Port ports[4];
+  uint8_t port_count;
+  uint8_t pins[4];  // only for Pwm
+
+  void Attach(int pin, CoilRegister Port::* coil) {
+    pinMode(pin, OUTPUT);
+#if defined(TEENSYDUINO)
+    volatile CoilRegister* out = portOutputRegister(pin);
+#else
+    volatile CoilRegister* out = portOutputRegister(digitalPinToPort(pin));
+#endif
+    int i = 0;
+    while (i < this->port_count && this->ports[i].out != out) {
+      i++;
+    }
+    Port& port = this->ports[i];
+    if (i == this->port_count) {
+      this->port_count++;
+      port.out = out;
+#if defined(TEENSYDUINO)
+      port.set = portSetRegister(pin);
+      port.clear = portClearRegister(pin);
+#endif
+      port.mask_a = port.mask_b = port.mask_c = port.mask_d = port.all = 0;
+    }
+    port.*coil = digitalPinToBitMask(pin);
+    port.all |= digitalPinToBitMask(pin);
+  }
+
+  public:
+  PortCoils(int pin_a, int pin_b, int pin_c, int pin_d) {
+    this->port_count = 0;
+    this->pins[0] = pin_a;
+    this->pins[1] = pin_b;
+    this->pins[2] = pin_c;
+    this->pins[3] = pin_d;
+    Attach(pin_a, &Port::mask_a);
+    Attach(pin_b, &Port::mask_b);
+    Attach(pin_c, &Port::mask_c);
+    Attach(pin_d, &Port::mask_d);
+  }
+
+  void Write(uint8_t state) {
+    for (uint8_t i = 0; i < this->port_count; i++) {
+      const Port& port = this->ports[i];
+      CoilRegister bits = (state & 8 ? port.mask_a : 0) | (state & 4 ? port.mask_b : 0)
+                        | (state & 2 ? port.mask_c : 0) | (state & 1 ? port.mask_d : 0);
+#if defined(TEENSYDUINO)
+      *port.clear = port.all & ~bits;
+      *port.set = bits;
+#else
+      uint8_t sreg = SREG;
+      cli();
+      *port.out = (*port.out & ~port.all) | bits;
+      SREG = sreg;
+#endif
+    }
+  }
+
+  void Pwm(int16_t ab, int16_t cd) {
+    CoilPwm(this->pins[0], this->pins[1], ab);
+    CoilPwm(this->pins[2], this->pins[3], cd);
+  }
+};
+
+#endif
+
+#if defined(__AVR_ATmega328P__) || defined(HOST_ARDUINO)
+
+// Uno/Nano pin map: 0-7 on PORTD, 8-13 on PORTB, 14-19 (A0-A5) on PORTC
+template <int PinA, int PinB, int PinC, int PinD>
+class FixedCoils {
+  static_assert(PinA < 20 && PinB < 20 && PinC < 20 && PinD < 20, "FixedCoils needs Uno/Nano pins 0-19");
+
+  private:
+  template <int Pin, int Port>
+  static uint8_t Mask() {
+    return (Port == 'D' && Pin < 8) ? 1 << Pin
+         : (Port == 'B' && Pin >= 8 && Pin < 14) ? 1 << (Pin - 8)
+         : (Port == 'C' && Pin >= 14 && Pin < 20) ? 1 << (Pin - 14) : 0;
+  }
+
+  // Every mask is a constant, so ports none of the pins are on drop out completely
+  template <int Port>
+  static void WritePort(volatile uint8_t& out, uint8_t state) {
+    const uint8_t a = Mask<PinA, Port>(), b = Mask<PinB, Port>(), c = Mask<PinC, Port>(), d = Mask<PinD, Port>();
+    if ((a | b | c | d) == 0) {
+      return;
+    }
+    uint8_t bits = (state & 8 ? a : 0) | (state & 4 ? b : 0) | (state & 2 ? c : 0) | (state & 1 ? d : 0);
+    out = (out & ~(a | b | c | d)) | bits;
+  }
+
+  public:
+  FixedCoils(int, int, int, int) {
+    pinMode(PinA, OUTPUT);
+    pinMode(PinB, OUTPUT);
+    pinMode(PinC, OUTPUT);
+    pinMode(PinD, OUTPUT);
+  }
+
+  void Write(uint8_t state) {
+    uint8_t sreg = SREG;
+    cli();
+    WritePort<'D'>(PORTD, state);
+    WritePort<'B'>(PORTB, state);
+    WritePort<'C'>(PORTC, state);
+    SREG = sreg;
+  }
+
+  void Pwm(int16_t ab, int16_t cd) {
+    CoilPwm(PinA, PinB, ab);
+    CoilPwm(PinC, PinD, cd);
+  }
+};
+
+#elif defined(COIL_PORT_IO)
+
+template <int PinA, int PinB, int PinC, int PinD>
+class FixedCoils : public PortCoils {
+  public:
+  FixedCoils(int, int, int, int) : PortCoils(PinA, PinB, PinC, PinD) {
+  }
+};
+
+#else
+
+template <int PinA, int PinB, int PinC, int PinD>
+class FixedCoils : public DigitalCoils {
+  public:
+  FixedCoils(int, int, int, int) : DigitalCoils(PinA, PinB, PinC, PinD) {
+  }
+};
+
+#endif
+
+#if defined(COIL_PORT_IO)
+typedef PortCoils DefaultCoils;
+#else
+typedef DigitalCoils DefaultCoils;
+#endif
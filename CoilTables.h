@@ -0,0 +1,63 @@
+// Coil sequences for a ScaraStepper, the one used is picked with STEP_DIVISION in ScaraConfig.h
+// step_number is an index into the table, so moving one step is an add and a mask whatever the table length is.
+//   1      full steps, both coils on all the time: 1010 0110 0101 1001 (the original four states)
+//   2      half steps, a one-coil state in between each of those: 1010 0010 0110 0100 0101 0001 1001 1000.
+//          Twice the resolution and smoother at low speed, but the one-coil states only have ~70% of the torque.
+//   4 8 16 microsteps, each coil is driven with PWM along a cosine (coil a/b) and a sine (coil c/d) so the rotor is
+//          pulled to points in between full steps. Every pin needs PWM for this, so it is Teensy only. On an AVR
+//          board pins 4, 7 and 8 don't have it (analogWrite just turns them on or off), and worse, analogWrite on
+//          pin 9 or 10 writes the duty into OCR1A, which is the TOP of the Timer1 tick StepEngine.h runs on, so
+//          every microstep of RightMotor would change the step interrupt's period. It doesn't build there.
+// Whatever the division, entry 0 (and every STEP_DIVISION-th one after it) is the same pole position as a full step,
+// so a position in steps is STEP_DIVISION times what it would be in full steps.
+#pragma once
+#include <stdint.h>
+#include "ScaraConfig.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define COIL_TABLE_READ(p) ((int16_t)pgm_read_word(p))
+#define COIL_TABLE_READ_BYTE(p) ((uint8_t)pgm_read_byte(p))
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define COIL_TABLE_READ(p) (*(p))
+#define COIL_TABLE_READ_BYTE(p) (*(p))
+#endif
+
+#define COIL_STATES (4 * STEP_DIVISION)
+#define COIL_STEP_MASK (COIL_STATES - 1)
+
+#if STEP_DIVISION == 1
+// Nibbles for Coils::Write, a = 8, b = 4, c = 2, d = 1
+const uint8_t CoilSequence[COIL_STATES] PROGMEM = {0xA, 0x6, 0x5, 0x9};
+#elif STEP_DIVISION == 2
+const uint8_t CoilSequence[COIL_STATES] PROGMEM = {0xA, 0x2, 0x6, 0x4, 0x5, 0x1, 0x9, 0x8};
+#else
+#if defined(__AVR__)
+#error "PWM microsteps (STEP_DIVISION 4, 8 or 16) need a Teensy, see the top of CoilTables.h"
+#endif
+#define COIL_PWM
+// 255 sin(45 + 90 i / STEP_DIVISION degrees), signed so the sign says which way the current goes.
+// Coil c/d is driven with entry i, coil a/b with entry i + STEP_DIVISION (a quarter turn on, the cosine).
+#if STEP_DIVISION == 4
+const int16_t CoilSine[COIL_STATES] PROGMEM = {
+  180, 236, 255, 236, 180, 98, 0, -98, -180, -236, -255, -236, -180, -98, 0, 98
+};
+#elif STEP_DIVISION == 8
+const int16_t CoilSine[COIL_STATES] PROGMEM = {
+  180, 212, 236, 250, 255, 250, 236, 212, 180, 142, 98, 50, 0, -50, -98, -142,
+  -180, -212, -236, -250, -255, -250, -236, -212, -180, -142, -98, -50, 0, 50, 98, 142
+};
+#elif STEP_DIVISION == 16
+const int16_t CoilSine[COIL_STATES] PROGMEM = {
+  180, 197, 212, 225, 236, 244, 250, 254, 255, 254, 250, 244, 236, 225, 212, 197,
+  180, 162, 142, 120, 98, 74, 50, 25, 0, -25, -50, -74, -98, -120, -142, -162,
+  -180, -197, -212, -225, -236, -244, -250, -254, -255, -254, -250, -244, -236, -225, -212, -197,
+  -180, -162, -142, -120, -98, -74, -50, -25, 0, 25, 50, 74, 98, 120, 142, 162
+};
+#else
+#error "STEP_DIVISION has to be 1, 2, 4, 8 or 16"
+#endif
+#endif
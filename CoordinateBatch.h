@@ -0,0 +1,204 @@
+// Batch version of CartesianTransfer for preprocessing whole toolpaths on the host
+// The points come in as structure-of-arrays (x[], y[]) and the angles go out the same way (theta[], phi[], valid[])
+// Uses AVX (8 points at a time) or SSE2 (4 points at a time) when the compiler has them turned on,
+// anything else (the boards included) falls back to calling CartesianTransfer on every point.
+//
+// The vector path does not call atan2. Since the reach check forces y > 0, atan2(y,x) is the same as acos(x/s1),
+// so every angle becomes an acos and they all share one polynomial (the cephes asinf one, ~1e-7 rad).
+// Results match CartesianTransfer to ~1e-6 rad everywhere, full reach included.
+// Points outside the area get valid = false and NAN for both angles.
+#pragma once
+#include "CoordinateTransfer.h"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__) || defined(__SSE2__)
+namespace ik_simd {
+
+// Every vector width gets the same small set of operations so the kernel below only has to be written once
+#if defined(__SSE2__)
+struct Sse {
+  typedef __m128 V;
+  static const int Width = 4;
+  static V load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+  static V set(float v) { return _mm_set1_ps(v); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm_div_ps(a, b); }
+  static V sqrt(V a) { return _mm_sqrt_ps(a); }
+  static V min(V a, V b) { return _mm_min_ps(a, b); }
+  static V max(V a, V b) { return _mm_max_ps(a, b); }
+  static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+  static V ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+  static V gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+  static V orr(V a, V b) { return _mm_or_ps(a, b); }
+  static V andd(V a, V b) { return _mm_and_ps(a, b); }
+  static V andnot(V a, V b) { return _mm_andnot_ps(a, b); }
+  static V select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  static int bits(V mask) { return _mm_movemask_ps(mask); }
+};
+#endif
+
+#if defined(__AVX__)
+struct Avx {
+  typedef __m256 V;
+  static const int Width = 8;
+  static V load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+  static V set(float v) { return _mm256_set1_ps(v); }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+  static V min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static V ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+  static V gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static V orr(V a, V b) { return _mm256_or_ps(a, b); }
+  static V andd(V a, V b) { return _mm256_and_ps(a, b); }
+  static V andnot(V a, V b) { return _mm256_andnot_ps(a, b); }
+  static V select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+  static int bits(V mask) { return _mm256_movemask_ps(mask); }
+};
+#endif
+
+// acos of every lane, x must already be clamped to [-1,1]
+// Small inputs use pi/2 - asin(x), large ones use 2*asin(sqrt((1-|x|)/2)), negatives are mirrored with pi - acos(|x|)
+// The caller passes 1-|x| in separately. Close to +-1 acos is very steep, and working out 1-|x| from the
+// geometry keeps the digits that subtracting from 1 in float would throw away.
+template <class S>
+inline typename S::V Acos(typename S::V x, typename S::V oneMinusAbs) {
+  typedef typename S::V V;
+  const V sign = S::set(-0.0f);
+  V a = S::andnot(sign, x);
+  V big = S::gt(a, S::set(0.5f));
+
+  V z = S::select(big, S::mul(S::set(0.5f), S::max(oneMinusAbs, S::set(0.0f))), S::mul(a, a));
+  V s = S::select(big, S::sqrt(z), a);
+
+  V p = S::set(4.2163199048e-2f);
+  p = S::add(S::mul(p, z), S::set(2.4181311049e-2f));
+  p = S::add(S::mul(p, z), S::set(4.5470025998e-2f));
+  p = S::add(S::mul(p, z), S::set(7.4953002686e-2f));
+  p = S::add(S::mul(p, z), S::set(1.6666752422e-1f));
+  V r = S::add(s, S::mul(S::mul(s, z), p));
+
+  V positive = S::select(big, S::add(r, r), S::sub(S::set(1.5707963268f), r));
+  V negative = S::sub(S::set(3.1415926536f), positive);
+  return S::select(S::lt(x, S::set(0.0f)), negative, positive);
+}
+
+template <class S>
+inline typename S::V Clamp(typename S::V v) {
+  return S::max(S::set(-1.0f), S::min(S::set(1.0f), v));
+}
+
+// Angle of (dx, y) from the x axis for y > 0, with s = its length
+// 1-|dx|/s is y^2 / (s * (s + |dx|)), which doesn't cancel out when the point is nearly on the axis
+template <class S>
+inline typename S::V Direction(typename S::V dx, typename S::V y, typename S::V s) {
+  typename S::V adx = S::andnot(S::set(-0.0f), dx);
+  return Acos<S>(Clamp<S>(S::div(dx, s)), S::div(S::mul(y, y), S::mul(s, S::add(s, adx))));
+}
+
+// Angle opposite c in a triangle with sides a (fixed), s and c (fixed), the same as CosineLaw(s, a, c)
+// 1-cos is (c-s+a)(c+s-a) / 2as and 1+cos is (s+a-c)(s+a+c) / 2as, both of which stay accurate at full reach
+template <class S>
+inline typename S::V Elbow(typename S::V s, float a, float c) {
+  typedef typename S::V V;
+  V twoAS = S::mul(S::set(2*a), s);
+  V cosine = S::div(S::add(S::mul(s, s), S::set(a*a - c*c)), twoAS);
+  V oneMinus = S::div(S::mul(S::add(S::set(c+a), S::sub(S::set(0.0f), s)), S::add(S::set(c-a), s)), twoAS);
+  V onePlus = S::div(S::mul(S::add(s, S::set(a-c)), S::add(s, S::set(a+c))), twoAS);
+  return Acos<S>(Clamp<S>(cosine), S::select(S::lt(cosine, S::set(0.0f)), onePlus, oneMinus));
+}
+
+// Solves S::Width points starting at index i, returns how many of them were reachable
+template <class S, class Arm>
+inline int Solve(const float* xs, const float* ys, float* theta, float* phi, bool* valid, int i) {
+  typedef typename S::V V;
+  V x = S::load(xs + i);
+  V y = S::load(ys + i);
+  V xb = S::sub(x, S::set(Arm::Base));
+
+  V s1 = S::sqrt(S::add(S::mul(x, x), S::mul(y, y)));
+  V s2 = S::sqrt(S::add(S::mul(xb, xb), S::mul(y, y)));
+
+  // Same three checks as CartesianTransfer
+  V outside = S::orr(S::lt(y, S::set(Arm::MinY)),
+                     S::orr(S::ge(s1, S::set(Arm::LeftReach)), S::ge(s2, S::set(Arm::RightReach))));
+
+  // Joint A: ta3 + ta2
+  V ta3 = Direction<S>(x, y, s1);
+  V ta2 = Elbow<S>(s1, Arm::A, Arm::B);
+
+  // Joint C: atan2(y, x-B) - tc2
+  V tc1 = Direction<S>(xb, y, s2);
+  V tc2 = Elbow<S>(s2, Arm::C, Arm::D);
+
+  V nan = S::set(NAN);
+  S::store(theta + i, S::select(outside, nan, S::add(ta2, ta3)));
+  S::store(phi + i, S::select(outside, nan, S::sub(tc1, tc2)));
+
+  int mask = S::bits(outside);
+  int count = 0;
+  for (int lane = 0; lane < S::Width; lane++) {
+    valid[i + lane] = !(mask & (1 << lane));
+    count += valid[i + lane];
+  }
+  return count;
+}
+
+}  // namespace ik_simd
+#endif
+
+// Solves count points, returns how many were within the area
+template <class Arm = KindLadyArm>
+inline int CartesianTransferBatch(const float* x, const float* y, float* theta, float* phi, bool* valid, int count) {
+  int reachable = 0;
+  int i = 0;
+
+#if defined(__AVX__)
+  for (; i + ik_simd::Avx::Width <= count; i += ik_simd::Avx::Width) {
+    reachable += ik_simd::Solve<ik_simd::Avx, Arm>(x, y, theta, phi, valid, i);
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + ik_simd::Sse::Width <= count; i += ik_simd::Sse::Width) {
+    reachable += ik_simd::Solve<ik_simd::Sse, Arm>(x, y, theta, phi, valid, i);
+  }
+#endif
+
+  // Whatever is left over (or everything, without SIMD) goes through the scalar function
+  for (; i < count; i++) {
+    valid[i] = CartesianTransfer<Arm>(x[i], y[i], theta[i], phi[i]);
+    if (!valid[i]) {
+      theta[i] = NAN;
+      phi[i] = NAN;
+    }
+    reachable += valid[i];
+  }
+  return reachable;
+}
+
+// Batch version of ForwardTransfer, for turning logged angles back into positions
+// This one is a plain loop, sin/cos are the bulk of the cost and the compiler's own vectorizer can have a go at it.
+template <class Arm = KindLadyArm>
+inline int ForwardTransferBatch(const float* theta, const float* phi, float* x, float* y, bool* valid, int count) {
+  int solved = 0;
+  for (int i = 0; i < count; i++) {
+    valid[i] = ForwardTransfer<Arm>(theta[i], phi[i], x[i], y[i]);
+    if (!valid[i]) {
+      x[i] = NAN;
+      y[i] = NAN;
+    }
+    solved += valid[i];
+  }
+  return solved;
+}
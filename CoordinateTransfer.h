@@ -1,46 +1,212 @@
 // This header file is to do the math to transfer between cartesians coordinates and the Scara angles
 // Inputting the desired cartesian coordinates will output the two angles or NAN if outside the area
-#define A1 80
-#define B1 100
-#define C1 80
-#define D1 100
-#define B 50
+// ForwardTransfer goes from the angles back to the coordinates, Jacobian and FeedLimit relate their speeds
+// The trig in CartesianTransfer can be swapped for the polynomials in FastMath.h with FAST_MATH_TIER
+#pragma once
+#include <math.h>
+#include "FastMath.h"
 
+// Link lengths of one five bar arm, all in mm
+// A: left motor to left elbow, B: left elbow to tool, C: right motor to right elbow, D: right elbow to tool
+// Base: distance between the motors (left motor at the origin, right motor at (Base, 0))
+// MinY: anything closer to the base line than this gets too close to the inner singularity
+// These used to be the A1/B1/C1/D1/B macros, which collided with the Arduino A1 pin and B1 binary constant.
+// Everything derived from them is worked out here at compile time, so any number of arms can share one binary.
+template <int LinkA, int LinkB, int LinkC, int LinkD, int BaseWidth, int MinimumY = 28>
+struct FiveBarGeometry {
+  static constexpr float A = LinkA;
+  static constexpr float B = LinkB;
+  static constexpr float C = LinkC;
+  static constexpr float D = LinkD;
+  static constexpr float Base = BaseWidth;
+  static constexpr float MinY = MinimumY;
+
+  // Reach of each side with the elbow straight, and folded all the way in
+  static constexpr float LeftReach = LinkA + LinkB;
+  static constexpr float RightReach = LinkC + LinkD;
+  static constexpr float LeftFold = LinkB - LinkA;
+  static constexpr float RightFold = LinkD - LinkC;
+};
+
+// The arm this project is built around
+typedef FiveBarGeometry<80, 100, 80, 100, 50> KindLadyArm;
+
+float CosineLaw( float a, float b, float c) {
+  return acos( ( pow(a,2) + pow(b,2) - pow(c,2) ) / (2 * a * b));
+}
+
+// CosineLaw(s, a, c) for a triangle with one side s that moves, written with the half angle formula
+// tan(angle/2)^2 = (1-cos)/(1+cos) = (reach-s)(s+fold) / ((s-fold)(s+reach)) with reach = a+c and fold = c-a.
+// Near full reach the cosine is so close to 1 that acos of a float loses ~1e-4 rad, this form keeps (reach-s) exact.
+// With the FastMath.h polynomials sqrt(n/d) is worked out as n/sqrt(n*d), which swaps the divide and sqrt for one
+// FastRsqrt. Its relative error moves the angle by at most the same amount, unlike an error in s itself.
+template <int Tier = FAST_MATH_TIER>
+inline float ArmAngle(float s, float reach, float fold) {
+  if (Tier == 0) {
+    return 2 * atan(sqrt( (reach - s) * (s + fold) / ((s - fold) * (s + reach)) ));
+  }
+  float n = (reach - s) * (s + fold);
+  return 2 * FastAtan<Tier>(n * FastRsqrt<Tier>(n * (s - fold) * (s + reach)));
+}
+
+template <class Arm, int Tier = FAST_MATH_TIER>
 bool CartesianTransfer(float x, float y, float& theta, float& phi) {
   // Calculates inital intermediate arm lengths
-  float s1 = sqrt(pow(x,2)+pow(y,2));
-  float s2 = sqrt(pow(x-B,2)+pow(y,2));
-  
+  // Plain sqrt on every tier, near full reach the angle is so steep in s that even a 1 ulp error shows
+  float s1 = sqrt(x*x + y*y);
+  float s2 = sqrt((x-Arm::Base)*(x-Arm::Base) + y*y);
+
   //check if within the range of the arms
   // First check ensures that the robot will not cross the inner singularity
   // Second and Third ensure that the point is within the reach of both arms
 
-  if ( (y < 28) || (s1 >= A1+B1) || (s2 >= C1+D1) ) {
+  if ( (y < Arm::MinY) || (s1 >= Arm::LeftReach) || (s2 >= Arm::RightReach) ) {
     return false;
   }
 
   //Joint A
-  float ta3 = atan2(y,x);
-  float ta2 = CosineLaw(s1,A1,B1);
-  float ta1 = 3.14159 - ta2-ta3;
-
-  //Joint B
-  float tb1 = CosineLaw(B1,A1,s1);
+  float ta3 = FastAtan2<Tier>(y,x);
+  float ta2 = ArmAngle<Tier>(s1, Arm::LeftReach, Arm::LeftFold);  // CosineLaw(s1,A,B)
 
   //Joint C
-  float tc1 = 3.14159 - atan2(y,x-B);
-  float tc2 = CosineLaw(C1,s2,D1);
-  float tc3 = 3.14159 - tc1 - tc2;
+  // tc3 = pi - tc1 - tc2 with tc1 = pi - atan2(y,x-Base), so the pi's cancel
+  float tc1 = FastAtan2<Tier>(y,x-Arm::Base);
+  float tc2 = ArmAngle<Tier>(s2, Arm::RightReach, Arm::RightFold);  // CosineLaw(C,s2,D)
 
-  //Joint D
-  float td1 = CosineLaw(D1,C1,s2);
+  // Joints B and D (the elbows) aren't needed for the motor angles
 
   theta = ta2 + ta3;
-  phi = tc3;
-  
+  phi = tc1 - tc2;
+
   return true;
 };
 
-float CosineLaw( float a, float, b, float c) {
-  return acos( ( pow(a,2) + pow(b,2) - pow(c,2) ) / (2 * a * b));
+bool CartesianTransfer(float x, float y, float& theta, float& phi) {
+  return CartesianTransfer<KindLadyArm>(x, y, theta, phi);
+}
+
+// Goes the other way, from the two motor angles to the tool position
+// Each elbow is a fixed distance from the tool, so the tool sits where the circle of radius B around the left elbow
+// meets the circle of radius D around the right elbow. Of the two crossings, CartesianTransfer's working mode is the
+// one on the left of the line from the left elbow to the right elbow (the one further from the base).
+// Returns false when the circles don't meet. The position is not checked against the reachable area.
+template <class Arm>
+bool ForwardTransfer(float theta, float phi, float& x, float& y) {
+  // Elbow positions
+  float ex1 = Arm::A * cos(theta);
+  float ey1 = Arm::A * sin(theta);
+  float ex2 = Arm::Base + Arm::C * cos(phi);
+  float ey2 = Arm::C * sin(phi);
+
+  float dx = ex2 - ex1;
+  float dy = ey2 - ey1;
+  float l2 = dx*dx + dy*dy;
+  float l = sqrt(l2);
+  if ( (l >= Arm::B + Arm::D) || (l <= fabs(Arm::B - Arm::D)) ) {
+    return false;
+  }
+
+  // Distance along the elbow line to the chord between the crossings, then half the chord
+  float along = (Arm::B*Arm::B - Arm::D*Arm::D + l2) / (2 * l);
+  float h = sqrt(Arm::B*Arm::B - along*along);
+
+  x = ex1 + (along * dx - h * dy) / l;
+  y = ey1 + (along * dy + h * dx) / l;
+  return true;
+}
+
+bool ForwardTransfer(float theta, float phi, float& x, float& y) {
+  return ForwardTransfer<KindLadyArm>(theta, phi, x, y);
+}
+
+// Jacobian of the tool position with respect to the motor angles, J = [dx/dtheta dx/dphi; dy/dtheta dy/dphi] (mm/rad)
+// With u1 = tool - left elbow and u2 = tool - right elbow, keeping both distal links the same length gives
+// u1.dP = (u1.dE1/dtheta) dtheta and u2.dP = (u2.dE2/dphi) dphi, which is a 2x2 system for dP.
+// condition is the ratio of the largest to the smallest singular value. It blows up towards the inner singularity
+// (distal links lining up, near y = 28) and at full reach, and is INFINITY when J can't be inverted.
+template <class Arm>
+bool Jacobian(float theta, float phi, float J[2][2], float& condition) {
+  float x, y;
+  if (!ForwardTransfer<Arm>(theta, phi, x, y)) {
+    return false;
+  }
+
+  float u1x = x - Arm::A * cos(theta);
+  float u1y = y - Arm::A * sin(theta);
+  float u2x = x - Arm::Base - Arm::C * cos(phi);
+  float u2y = y - Arm::C * sin(phi);
+
+  // How much each distal link gets pushed along itself by its motor
+  float k1 = Arm::A * (u1y * cos(theta) - u1x * sin(theta));
+  float k2 = Arm::C * (u2y * cos(phi) - u2x * sin(phi));
+
+  float det = u1x * u2y - u1y * u2x;
+  if (det == 0) {
+    condition = INFINITY;
+    return false;
+  }
+  J[0][0] = u2y * k1 / det;
+  J[0][1] = -u1y * k2 / det;
+  J[1][0] = -u2x * k1 / det;
+  J[1][1] = u1x * k2 / det;
+
+  // Singular values of a 2x2 from its squared entries and determinant
+  float sum = J[0][0]*J[0][0] + J[0][1]*J[0][1] + J[1][0]*J[1][0] + J[1][1]*J[1][1];
+  float area = fabs(J[0][0]*J[1][1] - J[0][1]*J[1][0]);
+  float spread = sqrt(fmax(sum*sum - 4*area*area, 0.0f));
+  float smallest = sqrt((sum - spread) / 2);
+  condition = smallest > 0 ? sqrt((sum + spread) / 2) / smallest : INFINITY;
+  return true;
+}
+
+bool Jacobian(float theta, float phi, float J[2][2], float& condition) {
+  return Jacobian<KindLadyArm>(theta, phi, J, condition);
+}
+
+// Turns a tool speed into motor step rates at the pose (theta, phi)
+// (dx, dy) is the direction of travel (any length), feed is the speed wanted along it in mm/s.
+// The joint rates come from the inverse Jacobian, dtheta = u1.v / k1 and dphi = u2.v / k2 (see above), and are
+// converted with stepsPerRadian. If either motor would go over maxRate (steps/s) both are scaled down by the same
+// amount so the tool keeps its direction. leftRate/rightRate come back signed (+ is increasing angle).
+// Returns the feed that is actually possible there, or 0 if the pose is singular or the direction is zero.
+template <class Arm>
+float FeedLimit(float theta, float phi, float dx, float dy, float feed, float stepsPerRadian, float maxRate,
+                float& leftRate, float& rightRate) {
+  leftRate = 0;
+  rightRate = 0;
+
+  float x, y;
+  float length = sqrt(dx*dx + dy*dy);
+  if (length == 0 || !ForwardTransfer<Arm>(theta, phi, x, y)) {
+    return 0;
+  }
+  float vx = dx / length * feed;
+  float vy = dy / length * feed;
+
+  float u1x = x - Arm::A * cos(theta);
+  float u1y = y - Arm::A * sin(theta);
+  float u2x = x - Arm::Base - Arm::C * cos(phi);
+  float u2y = y - Arm::C * sin(phi);
+  float k1 = Arm::A * (u1y * cos(theta) - u1x * sin(theta));
+  float k2 = Arm::C * (u2y * cos(phi) - u2x * sin(phi));
+  if (k1 == 0 || k2 == 0) {
+    return 0;
+  }
+
+  leftRate = (u1x * vx + u1y * vy) / k1 * stepsPerRadian;
+  rightRate = (u2x * vx + u2y * vy) / k2 * stepsPerRadian;
+
+  float fastest = fmax(fabs(leftRate), fabs(rightRate));
+  if (fastest > maxRate) {
+    float scale = maxRate / fastest;
+    leftRate *= scale;
+    rightRate *= scale;
+    feed *= scale;
+  }
+  return feed;
+}
+
+float FeedLimit(float theta, float phi, float dx, float dy, float feed, float stepsPerRadian, float maxRate,
+                float& leftRate, float& rightRate) {
+  return FeedLimit<KindLadyArm>(theta, phi, dx, dy, feed, stepsPerRadian, maxRate, leftRate, rightRate);
 }
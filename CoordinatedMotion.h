@@ -0,0 +1,218 @@
+// Both ScaraSteppers driven from one step generator, so a move is a straight line in joint space
+// StepEngine runs each motor off its own queue, which is fine for jogging but turns a move where both joints turn
+// into a staircase: whichever motor is ahead gets there first. Here each queued segment is a pair of step counts
+// and a duration. The motor with more steps (the major axis) steps at duration / steps, and the other one is
+// stepped from the same ticks with Bresenham's line algorithm: it takes a step every time its running error
+// crosses over, which spreads its steps evenly over the major ones. Both land on their last step together and
+// the minor motor is never more than half a step off the line between the two end points.
+// The major axis is ramped with its motor's ProfileLimits like a StepEngine block, and since the minor one only
+// ever steps on major steps it follows the same ramp scaled down.
+//
+// Segments wait in a StepRing like the StepEngine blocks. Shares the StepEngine timer, so it's either this or a
+// StepEngine at any one time.
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include "StepEngine.h"
+
+#ifndef MOTION_QUEUE_SIZE
+#define MOTION_QUEUE_SIZE 16   // default ring size in segments, has to be a power of two
+#endif
+
+struct MotionSegment {
+  int16_t left, right;   // steps, signed like ScaraStepper::Advance
+  uint16_t ramp;         // major axis steps spent speeding up (and slowing down)
+  uint32_t interval;     // us between steps of the major axis once up to speed
+};
+
+template <class Stepper = ScaraStepper, uint8_t QueueSize = MOTION_QUEUE_SIZE>
+class CoordinatedMotion {
+  private:
+  Stepper* left;
+  Stepper* right;
+
+  StepRing<MotionSegment, QueueSize> queue;
+
+  // Running segment, only touched by Tick
+  bool running;
+  uint16_t major;          // major axis steps in the segment
+  uint16_t minor;          // minor axis steps in the segment
+  uint16_t remaining;      // major axis steps left
+  int16_t error;
+  int8_t left_direction, right_direction;
+  bool left_major;
+  StepProfile profile;
+  int32_t due;
+
+  volatile int32_t position[2];  // steps taken, signed
+  int32_t planned[2];            // where the last queued segment ends, main loop side
+
+  static CoordinatedMotion* active;
+
+  static void Interrupt() {
+    INSTRUMENT_SCOPE("motion isr");
+    active->Tick();
+  }
+
+  void Start(const MotionSegment& segment) {
+    uint16_t l = segment.left < 0 ? -segment.left : segment.left;
+    uint16_t r = segment.right < 0 ? -segment.right : segment.right;
+    this->left_direction = segment.left < 0 ? -1 : 1;
+    this->right_direction = segment.right < 0 ? -1 : 1;
+    this->left_major = l >= r;
+    this->major = this->left_major ? l : r;
+    this->minor = this->left_major ? r : l;
+    this->remaining = this->major;
+    this->error = this->major / 2;
+    this->profile.Start((this->left_major ? this->left : this->right)->printProfile(), this->major, segment.ramp,
+                        segment.interval);
+    this->due = this->profile.Next();
+    this->running = true;
+  }
+
+  void StepLeft() {
+    this->left->Advance(this->left_direction);
+    this->position[STEP_LEFT] += this->left_direction;
+    TRACE_EVENT(TRACE_STEP, STEP_LEFT, (int16_t)this->position[STEP_LEFT]);
+  }
+
+  void StepRight() {
+    this->right->Advance(this->right_direction);
+    this->position[STEP_RIGHT] += this->right_direction;
+    TRACE_EVENT(TRACE_STEP, STEP_RIGHT, (int16_t)this->position[STEP_RIGHT]);
+  }
+
+  public:
+  CoordinatedMotion(Stepper& left, Stepper& right) {
+    this->left = &left;
+    this->right = &right;
+    this->running = false;
+    this->position[STEP_LEFT] = this->position[STEP_RIGHT] = 0;
+    this->planned[STEP_LEFT] = this->planned[STEP_RIGHT] = 0;
+  }
+
+  void Begin() {
+    active = this;
+    StepTimerBegin(Interrupt);
+  }
+
+  void End() {
+    StepTimerEnd();
+  }
+
+  // Queues a move of left and right steps that takes duration us at full speed, false if the queue is full or
+  // either motor's steps are past STEP_BLOCK_MAX either way. Only call from the main loop. A move with no steps
+  // waits out the duration. The ramps at either end make it take longer, and a move too short to get up to speed
+  // is slowed down to what it can reach.
+  bool Push(long left, long right, uint32_t duration) {
+    if (labs(left) > STEP_BLOCK_MAX || labs(right) > STEP_BLOCK_MAX || this->queue.Free() == 0) {
+      return false;
+    }
+    uint16_t l = left < 0 ? -left : left;
+    uint16_t r = right < 0 ? -right : right;
+    uint16_t steps = l > r ? l : r;
+    uint32_t interval = steps ? duration / steps : duration;
+    float rate = 1000000.0f / (interval < STEP_TICK_US ? STEP_TICK_US : interval);
+    uint16_t ramp = PlanRamp((l >= r ? this->left : this->right)->printProfile(), steps, rate);
+
+    MotionSegment segment;
+    segment.left = left;
+    segment.right = right;
+    segment.ramp = ramp;
+    segment.interval = (uint32_t)(1000000.0f / rate);
+    this->queue.Push(segment);
+    TRACE_EVENT(TRACE_PUSH, TRACE_QUEUE_MOTION, this->queue.Count());
+    this->planned[STEP_LEFT] += left;
+    this->planned[STEP_RIGHT] += right;
+    return true;
+  }
+
+  // Same as Push, to absolute step positions (counted from where Begin was called)
+  bool MoveTo(long left, long right, uint32_t duration) {
+    return Push(left - this->planned[STEP_LEFT], right - this->planned[STEP_RIGHT], duration);
+  }
+
+  // Segments waiting, not counting the one running
+  int Queued() {
+    return this->queue.Count();
+  }
+
+  bool Idle() {
+    return Queued() == 0 && !this->running;
+  }
+
+  // Drops everything queued and stops where the motors are now (mid segment too)
+  void Stop() {
+    STEP_ENGINE_LOCK();
+    this->queue.Clear();
+    this->running = false;
+    this->planned[STEP_LEFT] = this->position[STEP_LEFT];
+    this->planned[STEP_RIGHT] = this->position[STEP_RIGHT];
+    STEP_ENGINE_UNLOCK();
+  }
+
+  // One timer tick, called from the interrupt
+  void Tick() {
+    if (!this->running) {
+      MotionSegment segment;
+      if (!this->queue.Take(segment)) {
+        return;
+      }
+      TRACE_EVENT(TRACE_POP, TRACE_QUEUE_MOTION, this->queue.Count());
+      Start(segment);
+    }
+
+    this->due -= STEP_TICK_US;
+    if (this->due > 0) {
+      return;
+    }
+    if (this->remaining == 0) {
+      this->running = false;  // a wait
+      return;
+    }
+
+    this->remaining--;
+    this->error -= this->minor;
+    bool minorStep = this->error < 0;
+    if (minorStep) {
+      this->error += this->major;
+    }
+    if (this->left_major) {
+      StepLeft();
+      if (minorStep) StepRight();
+    }
+    else {
+      StepRight();
+      if (minorStep) StepLeft();
+    }
+    if (this->remaining == 0) {
+      this->running = false;
+    }
+    else {
+      this->due += this->profile.Next();
+    }
+  }
+
+  long printPosition(int motor) {
+    STEP_ENGINE_LOCK();
+    long position = this->position[motor];
+    STEP_ENGINE_UNLOCK();
+    return position;
+  }
+
+  // Where the motors will be once everything queued has run
+  long printPlanned(int motor) {
+    return this->planned[motor];
+  }
+
+  // How far ahead the main loop keeps the motors, see StepRing.h
+  uint8_t printHighWatermark() {
+    return this->queue.printHighWatermark();
+  }
+  uint16_t printUnderruns() {
+    return this->queue.printUnderruns();
+  }
+};
+
+template <class Stepper, uint8_t QueueSize>
+CoordinatedMotion<Stepper, QueueSize>* CoordinatedMotion<Stepper, QueueSize>::active = 0;
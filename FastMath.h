@@ -0,0 +1,95 @@
+// Polynomial stand-ins for the libm calls in CartesianTransfer, picked at compile time with FAST_MATH_TIER
+//   0: libm (default)
+//   1: coarse, a few multiplies each
+//   2: fine
+//   3: as good as float gets
+// Everything is templated on the tier as well, so tools can compare tiers in one binary (tools/BenchFastMath.cpp).
+//
+// atan is an odd minimax polynomial on [0,1] (atan(1/a) = pi/2 - atan(a) covers the rest), and 1/sqrt is the bit
+// trick starting guess with one Newton step per tier. Coefficients come from a Remez fit of the relative error.
+// There is no acos: ArmAngle's half angle form does the elbows with atan and 1/sqrt, so CartesianTransfer doesn't
+// call it, and CosineLaw (which nothing in the IK uses any more) stays on libm.
+// sqrt itself is left alone: it is correctly rounded, a single instruction on the FPU boards, and near full reach
+// the elbow angle is so steep in s that an approximate s costs more than everything else put together.
+//
+// Worst error against double libm, then over the whole area at 0.25 mm: the worst motor angle error of
+// CartesianTransfer against tier 0, the tool error that gives through the Jacobian (everywhere, and where the
+// Jacobian condition number is under 10, away from the singular edges), and host time per point.
+//   tier  atan2    1/sqrt (rel) | IK angle  tool      tool (cond<10)  time
+//   0     2.4e-7   8.9e-8       | -         -         -               ~55 ns
+//   1     1.4e-3   1.8e-3       | 4.8e-3    6.6 mm    0.90 mm         ~20 ns
+//   2     2.7e-5   4.7e-6       | 8.1e-5    126 um    15 um           ~25 ns
+//   3     3.2e-7   1.4e-7       | 9.5e-7    6 um      0.15 um         ~35 ns
+// A full step is 31 mrad, so tier 2 is still under a 1/256 microstep (0.12 mrad). None of the tiers change which
+// points count as reachable, that check only uses sqrt.
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef FAST_MATH_TIER
+#define FAST_MATH_TIER 0
+#endif
+
+#define FAST_PI 3.14159265f
+#define FAST_HALF_PI 1.57079633f
+
+// atan(a) for 0 <= a <= 1
+template <int Tier>
+inline float AtanUnit(float a) {
+  float t = a * a;
+  if (Tier == 1) {
+    return a * (0.9985932708f + t * (-0.3023913205f + t * 0.09060288966f));
+  }
+  if (Tier == 2) {
+    return a * (0.9999732375f + t * (-0.3318031728f + t * (0.1857289225f + t * (-0.09274932742f
+           + t * 0.02427532896f))));
+  }
+  return a * (0.9999999404f + t * (-0.3333209455f + t * (0.1997137517f + t * (-0.1402941942f + t * (0.09942759573f
+         + t * (-0.05990471691f + t * (0.02455712669f + t * -0.004780455958f)))))));
+}
+
+template <int Tier>
+inline float FastAtan2(float y, float x) {
+  if (Tier == 0) {
+    return atan2(y, x);
+  }
+  float ax = fabs(x);
+  float ay = fabs(y);
+  float big = ax > ay ? ax : ay;
+  if (big == 0) {
+    return 0;
+  }
+  float angle = AtanUnit<Tier>((ax > ay ? ay : ax) / big);
+  if (ay > ax) {
+    angle = FAST_HALF_PI - angle;
+  }
+  if (x < 0) {
+    angle = FAST_PI - angle;
+  }
+  return y < 0 ? -angle : angle;
+}
+
+template <int Tier>
+inline float FastAtan(float z) {
+  if (Tier == 0) {
+    return atan(z);
+  }
+  return FastAtan2<Tier>(z, 1.0f);
+}
+
+template <int Tier>
+inline float FastRsqrt(float v) {
+  if (Tier == 0) {
+    return 1 / sqrt(v);
+  }
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  bits = 0x5f375a86 - (bits >> 1);
+  float r;
+  memcpy(&r, &bits, 4);
+  for (int i = 0; i < Tier; i++) {
+    r = r * (1.5f - 0.5f * v * r * r);
+  }
+  return r;
+}
@@ -0,0 +1,10 @@
+// The hardware the ScaraStepper code touches: pins, the ADC, time, Serial and the periodic timers
+// On a board that is the Arduino core as it is. Anywhere else HalLinux.h simulates an Uno, so the same headers
+// (and the FiveBarLinkage sketch) build into ordinary programs for tests, benchmarks and profilers, see tools/.
+// HalTimerBegin/HalTimerEnd only exist on the host, on a board StepEngine and PotSampler set up their own timers.
+#pragma once
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include "HalLinux.h"
+#endif
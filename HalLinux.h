@@ -0,0 +1,434 @@
+// Linux backend of Hal.h: an Uno simulated well enough to run the sketch headers as an ordinary program
+// The pin functions copy what the AVR core does on an Uno, including looking the port, mask and PWM timer up for
+// every digitalWrite, and PORTB/C/D are plain bytes, so the coil paths in CoilPins.h behave (and cost) the same.
+// On top of that:
+//   - time is virtual. micros() only moves when something waits (delay, delayMicroseconds) or HalAdvance is called,
+//     and the timers a board would run (StepEngine, PotSampler) are ticked at the right virtual times on the way.
+//     A run takes as long as the computer needs, not as long as the arm would.
+//   - every change of an output pin can be logged with the time it happened (HalRecording), whether it came from
+//     digitalWrite, analogWrite or a write to a port register
+//   - analog inputs come from HalAnalog, a script of timed values (HalScriptAnalog), or HalAnalogSource for anything
+//     that has to react to the outputs. Digital inputs the same way with HalInput and HalDigitalSource.
+//   - Serial takes as long as it would at its baud rate, and writes to HalSerialOut, stdout unless it is set to 0
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#define HOST_ARDUINO
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define HAL_PINS 20
+
+#define NOT_A_PIN 0
+#define NOT_ON_TIMER 0
+
+using std::max;
+using std::min;
+
+template <class T>
+T constrain(T value, T low, T high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+volatile uint8_t HalPorts[4];  // index 0 unused, like the AVR tables
+#define PORTB (HalPorts[1])
+#define PORTC (HalPorts[2])
+#define PORTD (HalPorts[3])
+volatile uint8_t SREG = 0x80;
+
+inline void cli() { SREG &= 0x7f; }
+inline void sei() { SREG |= 0x80; }
+inline void noInterrupts() { cli(); }
+inline void interrupts() { sei(); }
+
+// Uno tables from pins_arduino.h
+static const uint8_t HalPinPort[HAL_PINS] = {3,3,3,3,3,3,3,3, 1,1,1,1,1,1, 2,2,2,2,2,2};
+static const uint8_t HalPinMask[HAL_PINS] = {1,2,4,8,16,32,64,128, 1,2,4,8,16,32, 1,2,4,8,16,32};
+static const uint8_t HalPinTimer[HAL_PINS] = {0,0,0,1,0,2,3,0, 0,4,5,6,0,0, 0,0,0,0,0,0};
+volatile uint8_t HalPwm[8];
+
+#define digitalPinToPort(pin) ((pin) < HAL_PINS ? HalPinPort[(pin)] : NOT_A_PIN)
+#define digitalPinToBitMask(pin) ((pin) < HAL_PINS ? HalPinMask[(pin)] : 0)
+#define digitalPinToTimer(pin) ((pin) < HAL_PINS ? HalPinTimer[(pin)] : NOT_ON_TIMER)
+#define portOutputRegister(port) (&HalPorts[(port)])
+
+// Time
+
+uint64_t HalNow = 0;  // us
+
+inline unsigned long micros() {
+  return (unsigned long)HalNow;
+}
+
+inline unsigned long millis() {
+  return (unsigned long)(HalNow / 1000);
+}
+
+// Transition log
+
+struct HalTransition {
+  uint64_t time;   // us
+  uint8_t pin;
+  uint8_t value;   // LOW or HIGH, or the duty for analogWrite
+  bool pwm;
+};
+
+bool HalRecording = false;
+std::vector<HalTransition> HalLog;
+uint8_t HalSeen[4];          // port bytes as of the last HalSync
+uint8_t HalMode[HAL_PINS];   // pinMode
+int HalAnalogOut[HAL_PINS];  // last analogWrite
+
+inline void HalRecord(uint8_t pin, uint8_t value, bool pwm) {
+  if (HalRecording) {
+    HalTransition t = {HalNow, pin, value, pwm};
+    HalLog.push_back(t);
+  }
+}
+
+// Logs the port bits that changed since last time. Virtual time only moves in HalAdvance, which calls this before
+// moving it and after every timer tick, so a change gets the time it happened at however the pin was written.
+// (A pin that goes and comes back within the same instant doesn't show.)
+inline void HalSync() {
+  for (uint8_t port = 1; port < 4; port++) {
+    uint8_t changed = HalPorts[port] ^ HalSeen[port];
+    if (changed == 0) {
+      continue;
+    }
+    for (uint8_t pin = 0; pin < HAL_PINS; pin++) {
+      if (HalPinPort[pin] == port && (changed & HalPinMask[pin])) {
+        HalRecord(pin, HalPorts[port] & HalPinMask[pin] ? HIGH : LOW, false);
+      }
+    }
+    HalSeen[port] = HalPorts[port];
+  }
+}
+
+// Timers, what IntervalTimer and the AVR timer interrupts would be on a board
+
+struct HalTimer {
+  void (*tick)();
+  uint32_t period;  // us
+  uint64_t due;
+};
+
+std::vector<HalTimer> HalTimers;
+
+// Calls tick every period us of virtual time from now on, replacing any timer already calling it
+inline void HalTimerBegin(void (*tick)(), uint32_t period) {
+  for (size_t i = 0; i < HalTimers.size(); i++) {
+    if (HalTimers[i].tick == tick) {
+      HalTimers[i].period = period;
+      HalTimers[i].due = HalNow + period;
+      return;
+    }
+  }
+  HalTimer timer = {tick, period, HalNow + period};
+  HalTimers.push_back(timer);
+}
+
+inline void HalTimerEnd(void (*tick)()) {
+  for (size_t i = 0; i < HalTimers.size(); i++) {
+    if (HalTimers[i].tick == tick) {
+      HalTimers.erase(HalTimers.begin() + i);
+      return;
+    }
+  }
+}
+
+// Moves virtual time on by us, ticking every timer that comes due on the way in time order
+inline void HalAdvance(uint64_t us) {
+  uint64_t until = HalNow + us;
+  HalSync();
+  for (;;) {
+    size_t next = HalTimers.size();
+    for (size_t i = 0; i < HalTimers.size(); i++) {
+      if (HalTimers[i].due <= until && (next == HalTimers.size() || HalTimers[i].due < HalTimers[next].due)) {
+        next = i;
+      }
+    }
+    if (next == HalTimers.size()) {
+      break;
+    }
+    HalNow = HalTimers[next].due;
+    HalTimers[next].due += HalTimers[next].period;
+    HalTimers[next].tick();
+    HalSync();
+  }
+  HalNow = until;
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  HalAdvance(us);
+}
+
+inline void delay(unsigned long ms) {
+  HalAdvance((uint64_t)ms * 1000);
+}
+
+// Inputs
+
+int HalAnalog[6] = {512, 512, 512, 512, 512, 512};  // analogRead of A0-A5
+uint8_t HalInput[HAL_PINS];                            // digitalRead of pins that aren't outputs
+int (*HalAnalogSource)(uint8_t pin) = 0;               // overrides HalAnalog when set, pin is 0-5
+int (*HalDigitalSource)(uint8_t pin) = 0;              // overrides HalInput when set
+
+struct HalScriptPoint {
+  uint64_t time;
+  uint8_t pin;
+  int value;
+};
+
+std::vector<HalScriptPoint> HalScript;  // sorted by time, applied to HalAnalog as time passes
+size_t HalScriptNext = 0;
+
+// analogRead(pin) returns value from time on (until a later point for the same pin)
+inline void HalScriptAnalog(uint8_t pin, uint64_t time, int value) {
+  HalScriptPoint point = {time, (uint8_t)(pin >= A0 ? pin - A0 : pin), value};
+  size_t i = HalScript.size();
+  while (i > HalScriptNext && HalScript[i - 1].time > time) {
+    i--;
+  }
+  HalScript.insert(HalScript.begin() + i, point);
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < HAL_PINS) {
+    HalMode[pin] = mode;
+  }
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t val) {
+  uint8_t timer = digitalPinToTimer(pin);
+  uint8_t bit = digitalPinToBitMask(pin);
+  uint8_t port = digitalPinToPort(pin);
+  if (port == NOT_A_PIN) {
+    return;
+  }
+  if (timer != NOT_ON_TIMER) {
+    HalPwm[timer] = 0;
+  }
+  volatile uint8_t* out = portOutputRegister(port);
+  uint8_t oldSREG = SREG;
+  cli();
+  if (val == LOW) {
+    *out &= ~bit;
+  }
+  else {
+    *out |= bit;
+  }
+  SREG = oldSREG;
+}
+
+inline int digitalRead(uint8_t pin) {
+  uint8_t port = digitalPinToPort(pin);
+  if (port == NOT_A_PIN) {
+    return LOW;
+  }
+  if (HalMode[pin] == OUTPUT) {
+    return HalPorts[port] & digitalPinToBitMask(pin) ? HIGH : LOW;
+  }
+  return HalDigitalSource ? HalDigitalSource(pin) : HalInput[pin];
+}
+
+inline void analogWrite(uint8_t pin, int val) {
+  if (pin < HAL_PINS && HalAnalogOut[pin] != val) {
+    HalAnalogOut[pin] = val;
+    HalRecord(pin, (uint8_t)val, true);
+  }
+}
+
+inline int analogRead(uint8_t pin) {
+  uint8_t channel = pin >= A0 ? pin - A0 : pin;
+  while (HalScriptNext < HalScript.size() && HalScript[HalScriptNext].time <= HalNow) {
+    HalAnalog[HalScript[HalScriptNext].pin] = HalScript[HalScriptNext].value;
+    HalScriptNext++;
+  }
+  return HalAnalogSource ? HalAnalogSource(channel) : HalAnalog[channel];
+}
+
+// Serial
+// Paced like the AVR core's HardwareSerial at the rate begin() was given: bytes wait in a 64 byte TX buffer that
+// empties one byte every 10 bit times, and writing to a full one waits (in virtual time) for room. Before begin()
+// writes are instant. Everything written goes out to HalSerialOut and HalSerialTap as it is written.
+// Whatever plays the other end hands bytes to Serial.Receive, and they arrive one every 10 bit times into a 64 byte
+// RX buffer. Bytes that arrive while it is full are lost, like on the board, and counted in printOverruns.
+
+#define HAL_SERIAL_BUFFER 64
+
+FILE* HalSerialOut = stdout;
+void (*HalSerialTap)(uint8_t c) = 0;
+
+class HalSerialPort {
+  private:
+  struct Incoming {
+    uint64_t time;   // when it has arrived
+    uint8_t value;
+  };
+
+  uint32_t byte_us;  // 0 until begin()
+  uint64_t sent;     // when the last byte written will have gone out
+  std::vector<Incoming> incoming;
+  size_t arrived;    // incoming up to here are in rx or lost
+  std::vector<uint8_t> rx;
+  long overruns;
+
+  void Arrive() {
+    while (this->arrived < this->incoming.size() && this->incoming[this->arrived].time <= HalNow) {
+      if (this->rx.size() < HAL_SERIAL_BUFFER - 1) {
+        this->rx.push_back(this->incoming[this->arrived].value);
+      }
+      else {
+        this->overruns++;
+      }
+      this->arrived++;
+    }
+    if (this->arrived == this->incoming.size()) {
+      this->incoming.clear();
+      this->arrived = 0;
+    }
+  }
+
+  public:
+  HalSerialPort() {
+    this->byte_us = 0;
+    this->sent = 0;
+    this->arrived = 0;
+    this->overruns = 0;
+  }
+  void begin(unsigned long baud) {
+    this->byte_us = 10000000UL / baud;
+    this->sent = HalNow;
+  }
+  int availableForWrite() {
+    if (this->byte_us == 0 || this->sent <= HalNow) {
+      return HAL_SERIAL_BUFFER - 1;
+    }
+    long queued = (long)((this->sent - HalNow + this->byte_us - 1) / this->byte_us);
+    return queued < HAL_SERIAL_BUFFER - 1 ? HAL_SERIAL_BUFFER - 1 - queued : 0;
+  }
+  size_t write(uint8_t c) {
+    if (this->byte_us != 0) {
+      if (availableForWrite() == 0) {
+        HalAdvance(this->sent - (uint64_t)(HAL_SERIAL_BUFFER - 2) * this->byte_us - HalNow);
+      }
+      this->sent = (this->sent > HalNow ? this->sent : HalNow) + this->byte_us;
+    }
+    if (HalSerialOut) {
+      fputc(c, HalSerialOut);
+    }
+    if (HalSerialTap) {
+      HalSerialTap(c);
+    }
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      write(data[i]);
+    }
+    return length;
+  }
+  int available() {
+    Arrive();
+    return (int)this->rx.size();
+  }
+  int read() {
+    Arrive();
+    if (this->rx.empty()) {
+      return -1;
+    }
+    uint8_t c = this->rx.front();
+    this->rx.erase(this->rx.begin());
+    return c;
+  }
+
+  // The other end sends these, they arrive after anything it sent before
+  void Receive(const uint8_t* data, size_t length) {
+    uint64_t time = this->incoming.empty() ? HalNow : this->incoming.back().time;
+    time = time > HalNow ? time : HalNow;
+    for (size_t i = 0; i < length; i++) {
+      time += this->byte_us;
+      Incoming byte = {time, data[i]};
+      this->incoming.push_back(byte);
+    }
+  }
+  // Bytes the other end has sent that haven't arrived yet
+  size_t Pending() {
+    Arrive();
+    return this->incoming.size() - this->arrived;
+  }
+  long printOverruns() {
+    return this->overruns;
+  }
+
+  void print(const char* text) {
+    while (*text) {
+      write((uint8_t)*text++);
+    }
+  }
+  void print(char c) { write((uint8_t)c); }
+  void print(long value) {
+    char text[12];
+    snprintf(text, sizeof(text), "%ld", value);
+    print(text);
+  }
+  void print(int value) { print((long)value); }
+  void print(unsigned long value) {
+    char text[12];
+    snprintf(text, sizeof(text), "%lu", value);
+    print(text);
+  }
+  void print(unsigned int value) { print((unsigned long)value); }
+  void print(double value, int digits = 2) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    print(text);
+  }
+  void println() { print("\r\n"); }
+  template <class T>
+  void println(T value) {
+    print(value);
+    println();
+  }
+};
+
+HalSerialPort Serial;
+
+// Back to power on: time 0, pins low, no timers, scripts or log
+inline void HalReset() {
+  HalNow = 0;
+  Serial = HalSerialPort();
+  HalSerialTap = 0;
+  for (int i = 0; i < 4; i++) {
+    HalPorts[i] = HalSeen[i] = 0;
+  }
+  for (int i = 0; i < HAL_PINS; i++) {
+    HalMode[i] = INPUT;
+    HalInput[i] = LOW;
+    HalAnalogOut[i] = -1;
+  }
+  for (int i = 0; i < 6; i++) {
+    HalAnalog[i] = 512;
+  }
+  HalTimers.clear();
+  HalScript.clear();
+  HalScriptNext = 0;
+  HalLog.clear();
+  HalAnalogSource = 0;
+  HalDigitalSource = 0;
+}
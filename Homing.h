@@ -0,0 +1,107 @@
+// Finding home with the hall effect sensor (HES), the way README.md lays it out
+// The HES sits at 270 degrees lined up with a full step, and its comparator output reads HES_ACTIVE while the magnet
+// is close enough. Homing can't tell which side of it the arm starts on, so it goes:
+//   Hunting   HOMING_BLIND_STEPS the other way first (-direction). If the arm started behind the HES this crosses
+//             it, if it didn't then that is all that gets rammed into the other arm. Then back for up to
+//             HOMING_SEARCH_STEPS. Nothing in either and it gives up with the coils off. If the HES is already on,
+//             it backs out of the field and comes in again instead.
+//   Tracking  on through the field, slowed down to HOMING_SLOW_US a step, until the HES goes off again
+//   Aiming    back through the field the other way just as slowly, noting where it comes on and goes off
+// Home is the middle of the field averaged over both ways through, so the comparator's hysteresis (every edge shows
+// up a little late in the direction of travel) cancels out. The motor is left on the full step nearest to it.
+// README.md has the aiming sweep microstepping with a raised threshold. The step division is fixed at compile time
+// here (STEP_DIVISION) and the threshold is a trimpot, so aiming is the slower sweep at whatever division is built.
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "Hal.h"
+#include "ScaraConfig.h"
+#include "Trace.h"
+
+// Where the edges were, in steps from where Homing started (Advance(1) counts +1)
+struct HomingReport {
+  long on[2], off[2];  // HES came on and went off, tracking then aiming
+  long home;           // where the motor was left
+};
+
+inline bool HomingActive(uint8_t hes_pin) {
+  return digitalRead(hes_pin) == HES_ACTIVE;
+}
+
+// Steps until the HES reads active (or not), at most limit steps. False if it never did.
+template <class Stepper>
+bool HomingSweep(Stepper& motor, uint8_t hes_pin, int direction, long limit, bool active, uint32_t wait,
+                 long& position) {
+  for (long i = 0; i < limit; i++) {
+    if (HomingActive(hes_pin) == active) {
+      if (i > 0) {
+        TRACE_EVENT(TRACE_HES, hes_pin, active);  // an edge, not just where it started
+      }
+      return true;
+    }
+    motor.Advance(direction);
+    position += direction;
+    delayMicroseconds(wait);
+  }
+  if (HomingActive(hes_pin) != active) {
+    return false;
+  }
+  TRACE_EVENT(TRACE_HES, hes_pin, active);
+  return true;
+}
+
+// Homes one motor. direction (1 or -1) is the way towards the HES from the working area, in Advance terms.
+template <class Stepper>
+bool Homing(Stepper& motor, uint8_t hes_pin, int direction = 1, HomingReport* report = 0) {
+  HomingReport r = {{0, 0}, {0, 0}, 0};
+  long position = 0;
+  int start = motor.printStep();
+  pinMode(hes_pin, INPUT);
+  motor.Advance(0);  // hold where it is
+
+  // Hunting. Starting over the HES, it backs out of the field first so tracking still sees both edges.
+  if (HomingActive(hes_pin)) {
+    if (!HomingSweep(motor, hes_pin, -direction, HOMING_FIELD_STEPS, false, HOMING_SLOW_US, position) ||
+        !HomingSweep(motor, hes_pin, direction, HOMING_FIELD_STEPS, true, HOMING_SLOW_US, position)) {
+      motor.Off();
+      return false;
+    }
+  }
+  else if (HomingSweep(motor, hes_pin, -direction, HOMING_BLIND_STEPS, true, HOMING_FAST_US, position)) {
+    direction = -direction;  // it was behind the HES, so carry on through it this way
+  }
+  else if (!HomingSweep(motor, hes_pin, direction, HOMING_SEARCH_STEPS, true, HOMING_FAST_US, position)) {
+    motor.Off();
+    return false;
+  }
+  r.on[0] = position;
+
+  // Tracking
+  bool found = HomingSweep(motor, hes_pin, direction, HOMING_FIELD_STEPS, false, HOMING_SLOW_US, position);
+  r.off[0] = position;
+
+  // Aiming
+  found = found && HomingSweep(motor, hes_pin, -direction, HOMING_FIELD_STEPS, true, HOMING_SLOW_US, position);
+  r.on[1] = position;
+  found = found && HomingSweep(motor, hes_pin, -direction, HOMING_FIELD_STEPS, false, HOMING_SLOW_US, position);
+  r.off[1] = position;
+  if (!found) {
+    motor.Off();  // the field is wider than HOMING_FIELD_STEPS, so it isn't the HES magnet
+    return false;
+  }
+
+  float middle = (r.on[0] + r.off[0] + r.on[1] + r.off[1]) / 4.0f;
+
+  // Nearest full step, where the coil table index is a multiple of STEP_DIVISION again
+  r.home = lroundf((middle + start) / STEP_DIVISION) * STEP_DIVISION - start;
+  while (position != r.home) {
+    int way = r.home > position ? 1 : -1;
+    motor.Advance(way);
+    position += way;
+    delayMicroseconds(HOMING_SLOW_US);
+  }
+  if (report) {
+    *report = r;
+  }
+  return true;
+}
@@ -0,0 +1,215 @@
+// Timing of named pieces of code on the board itself: count, min, mean, max and a histogram for each
+// Scheduler.h says how late and how long each main loop task was, in micros() steps. This goes finer and anywhere,
+// interrupts included: put INSTRUMENT_SCOPE("name"); at the top of a block and every time the block runs, the time
+// from there to the end of the block is added to that name's counters.
+//   clock      the cycle counter (DWT CYCCNT) on a Teensy, so a Teensy 4.1 times to 1/600 us, micros() elsewhere
+//              (4 us steps on an Uno, fine for loop() and the worst cases, not for anything short), and a real
+//              nanosecond clock on the host (HalLinux.h's micros() is virtual time, it doesn't move while code runs)
+//   histogram  INSTRUMENT_BUCKETS powers of two in us: under 1, under 2, under 4 ... and the rest in the last one
+// InstrumentDump prints every scope as text. The sketch does that when a '?' command frame comes in over serial
+// (XYStream.h, '!' clears the counters), after flushing the telemetry ring so the text lands between frames, and the
+// decoders skip it like any other bytes that aren't a frame. tools/XYSend.cpp --dump asks for one and prints it, or
+// pull it out of a capture with: strings capture.bin | sed -n '/^# instrument/,/^# end/p'
+//
+// All of it is only there with INSTRUMENT defined (ScaraConfig.h, or -DINSTRUMENT on the host). Without it the
+// macros are empty and InstrumentDump does nothing, so the scopes can stay in the code.
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "Hal.h"
+#include "ScaraConfig.h"
+#if defined(INSTRUMENT) && defined(HOST_ARDUINO)
+#include <time.h>
+#endif
+
+#define INSTRUMENT_JOIN2(a, b) a##b
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b)
+
+// Interrupts off around something an interrupt could also be doing, and back to how they were after (from an
+// interrupt too, where they have to stay off). Trace.h and PotSampler.h use it too, so it's there with INSTRUMENT off.
+class InstrumentLock {
+  private:
+#if defined(TEENSYDUINO)
+  uint32_t primask;
+#else
+  uint8_t sreg;
+#endif
+
+  public:
+  InstrumentLock() {
+#if defined(TEENSYDUINO)
+    __asm__ volatile("mrs %0, primask" : "=r"(this->primask));
+    __disable_irq();
+#else
+    this->sreg = SREG;
+    cli();
+#endif
+  }
+  ~InstrumentLock() {
+#if defined(TEENSYDUINO)
+    if (!(this->primask & 1)) {
+      __enable_irq();
+    }
+#else
+    SREG = this->sreg;
+#endif
+  }
+};
+
+#if defined(INSTRUMENT)
+
+#define INSTRUMENT_BUCKETS 16
+
+#if defined(TEENSYDUINO)
+#if defined(__IMXRT1062__)
+#define INSTRUMENT_TICKS_PER_US (F_CPU_ACTUAL / 1000000)  // F_CPU_ACTUAL follows set_arm_clock()
+#else
+#define INSTRUMENT_TICKS_PER_US (F_CPU / 1000000)
+#endif
+inline uint32_t InstrumentNow() {
+  return ARM_DWT_CYCCNT;
+}
+#elif defined(HOST_ARDUINO)
+#define INSTRUMENT_TICKS_PER_US 1000
+inline uint32_t InstrumentNow() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+#else
+#define INSTRUMENT_TICKS_PER_US 1
+inline uint32_t InstrumentNow() {
+  return micros();
+}
+#endif
+
+// Counters of one scope. Zero initialised statics, so there's no constructor to run (or guard) in an interrupt,
+// and it goes on the list the first time it records something.
+struct InstrumentScope {
+  const char* name;
+  InstrumentScope* next;
+  bool listed;
+  uint32_t count;
+  uint32_t min, max;  // ticks
+  uint64_t sum;       // ticks
+  uint16_t buckets[INSTRUMENT_BUCKETS];  // stop counting at 65535
+};
+
+InstrumentScope* InstrumentScopes = 0;
+
+inline void InstrumentBegin() {
+#if defined(TEENSYDUINO)
+  // The Teensy 4 startup code already has the cycle counter running, a Teensy 3 needs it turned on
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+inline void InstrumentRecord(InstrumentScope& scope, uint32_t ticks) {
+  if (scope.count == 0) {
+    InstrumentLock lock;
+    if (!scope.listed) {
+      scope.next = InstrumentScopes;
+      scope.listed = true;
+      InstrumentScopes = &scope;
+    }
+    scope.min = ticks;
+  }
+  scope.count++;
+  if (ticks < scope.min) {
+    scope.min = ticks;
+  }
+  if (ticks > scope.max) {
+    scope.max = ticks;
+  }
+  scope.sum += ticks;
+  uint32_t us = ticks / INSTRUMENT_TICKS_PER_US;
+  uint8_t bucket = 0;
+  while (us && bucket < INSTRUMENT_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  if (scope.buckets[bucket] != 0xffff) {
+    scope.buckets[bucket]++;
+  }
+}
+
+// Times from where it is made to the end of the block it is in
+class InstrumentTimer {
+  private:
+  InstrumentScope& scope;
+  uint32_t start;
+
+  public:
+  InstrumentTimer(InstrumentScope& scope) : scope(scope) {
+    this->start = InstrumentNow();
+  }
+  ~InstrumentTimer() {
+    InstrumentRecord(this->scope, InstrumentNow() - this->start);
+  }
+};
+
+#define INSTRUMENT_SCOPE(name)                                                                             \
+  static InstrumentScope INSTRUMENT_JOIN(instrument_scope_, __LINE__) = {name, 0, false, 0, 0, 0, 0, {0}}; \
+  InstrumentTimer INSTRUMENT_JOIN(instrument_timer_, __LINE__)(INSTRUMENT_JOIN(instrument_scope_, __LINE__))
+
+// Clears every scope's counters, they stay on the list
+inline void InstrumentReset() {
+  for (InstrumentScope* scope = InstrumentScopes; scope; scope = scope->next) {
+    InstrumentLock lock;
+    InstrumentScope* next = scope->next;
+    const char* name = scope->name;
+    memset(scope, 0, sizeof(*scope));
+    scope->name = name;
+    scope->next = next;
+    scope->listed = true;
+  }
+}
+
+// A line per scope: name count min mean max (us) then the histogram buckets
+template <class Out>
+void InstrumentDump(Out& out) {
+  out.println();  // off the end of whatever binary came before, so the header starts a line
+  out.print("# instrument, us, buckets count under 1 2 4 8 ... us and the rest last");
+  out.println();
+  for (InstrumentScope* scope = InstrumentScopes; scope; scope = scope->next) {
+    InstrumentScope copy;
+    {
+      InstrumentLock lock;  // an interrupt's scope could be halfway through an update
+      copy = *scope;
+    }
+    double ticks = INSTRUMENT_TICKS_PER_US;
+    out.print(copy.name);
+    out.print(' ');
+    out.print((unsigned long)copy.count);
+    out.print(' ');
+    out.print(copy.min / ticks, 2);
+    out.print(' ');
+    out.print(copy.count ? copy.sum / ticks / copy.count : 0.0, 2);
+    out.print(' ');
+    out.print(copy.max / ticks, 2);
+    for (uint8_t i = 0; i < INSTRUMENT_BUCKETS; i++) {
+      out.print(' ');
+      out.print((unsigned int)copy.buckets[i]);
+    }
+    out.println();
+  }
+  out.print("# end");
+  out.println();
+}
+
+#else
+
+#define INSTRUMENT_SCOPE(name)
+
+inline void InstrumentBegin() {
+}
+
+inline void InstrumentReset() {
+}
+
+template <class Out>
+void InstrumentDump(Out&) {
+}
+
+#endif
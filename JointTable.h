@@ -0,0 +1,206 @@
+// Lookup table version of CartesianTransfer for the real-time loop
+// The reachable area is sampled onto a square grid ahead of time (tools/JointTableGen.cpp) and the angles in
+// between grid points are found with bilinear interpolation, so a lookup costs a few multiplies instead of acos/atan2.
+//
+// Angles are stored as int16 in units of 1/JOINT_TABLE_SCALE rad (about 0.24 mrad), which covers +-8 rad. Theta
+// goes up to about 4.3 rad in the workspace, so 8192 a rad (+-4 rad) would wrap. The builder stores anything that
+// doesn't fit as unreachable, so the cells around it fall back instead of interpolating a wrapped angle.
+// Cells where the interpolation error (storage rounding included) would be more than the tolerance given to the
+// generator, or that touch the edge of the area, are flagged and fall back to CartesianTransfer. That makes the
+// tolerance the worst-case angular error of JointTableTransfer, 0.5 mrad by default (~0.09 mm at 180 mm reach).
+// The generator checks every cell at 9x9 points and stores the worst error it found in max_error.
+//
+// Grid step vs. size (box -130..180 x 28..180 mm) and how many of the cells inside the area still fall back
+// at the default tolerance. Those are the ones close to full reach of either arm, where acos gets steep.
+//   4 mm -> 13 KB, 53% fall back     2 mm -> 50 KB, 16% fall back     1 mm -> 198 KB, 5% fall back
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "CoordinateTransfer.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#endif
+
+#define JOINT_TABLE_SCALE 4096.0f
+#define JOINT_TABLE_EMPTY INT16_MIN
+#define JOINT_TABLE_VERSION 2  // of the blob, 1 was 8192 a rad
+
+struct JointTable {
+  float x0, y0;       // grid point (0,0) in mm
+  float step;         // grid spacing in mm
+  uint16_t cols, rows;
+  float max_error;    // worst error the generator measured, rad
+  const int16_t* theta;      // rows * cols, row major, JOINT_TABLE_EMPTY where unreachable
+  const int16_t* phi;
+  const uint8_t* fallback;   // one bit per cell ((cols-1) * (rows-1)), set = use CartesianTransfer there
+  bool progmem;              // the arrays are in flash (the generated header), not RAM. Only matters on AVR.
+};
+
+// The arrays are read through these so a table can be in flash or RAM on AVR
+inline int16_t JointTableRead(const JointTable& table, const int16_t* p) {
+#if defined(__AVR__)
+  if (table.progmem) {
+    return (int16_t)pgm_read_word(p);
+  }
+#else
+  (void)table;  // only AVR has flash that can't be read like RAM
+#endif
+  return *p;
+}
+
+inline uint8_t JointTableReadByte(const JointTable& table, const uint8_t* p) {
+#if defined(__AVR__)
+  if (table.progmem) {
+    return (uint8_t)pgm_read_byte(p);
+  }
+#else
+  (void)table;  // only AVR has flash that can't be read like RAM
+#endif
+  return *p;
+}
+
+// Points a table at a blob written by JointTableGen --binary, loaded into RAM (from SD or a host). The blob has to
+// stay around while the table is used. Returns false if it isn't a table this code understands.
+inline bool JointTableFromBlob(const uint8_t* blob, JointTable& table) {
+  if (blob[0] != 'K' || blob[1] != 'L' || blob[2] != 'J' || blob[3] != 'T' || blob[4] != JOINT_TABLE_VERSION ||
+      blob[5] != 0) {
+    return false;
+  }
+  memcpy(&table.cols, blob + 6, 2);
+  memcpy(&table.rows, blob + 8, 2);
+  memcpy(&table.x0, blob + 10, 4);
+  memcpy(&table.y0, blob + 14, 4);
+  memcpy(&table.step, blob + 18, 4);
+  memcpy(&table.max_error, blob + 22, 4);
+
+  // The arrays start at an even offset so they can be read in place
+  int points = table.cols * table.rows;
+  table.theta = (const int16_t*)(blob + 26);
+  table.phi = table.theta + points;
+  table.fallback = (const uint8_t*)(table.phi + points);
+  table.progmem = false;
+  return true;
+}
+
+// Number of bytes needed for the fallback bits of a cols x rows grid
+inline int JointTableFallbackBytes(int cols, int rows) {
+  return ((cols - 1) * (rows - 1) + 7) / 8;
+}
+
+// Bilinear interpolation inside cell (col, row), fx and fy go from 0 to 1 across the cell
+// Corners: 00 is (col,row), 10 is (col+1,row) and so on
+inline void JointTableInterpolate(const JointTable& table, int col, int row, float fx, float fy, float& theta,
+                                  float& phi) {
+  int i = row * table.cols + col;
+  float w00 = (1-fx) * (1-fy);
+  float w10 = fx * (1-fy);
+  float w01 = (1-fx) * fy;
+  float w11 = fx * fy;
+
+  const int16_t* t = table.theta + i;
+  const int16_t* p = table.phi + i;
+  theta = (w00 * JointTableRead(table, t) + w10 * JointTableRead(table, t + 1)
+         + w01 * JointTableRead(table, t + table.cols) + w11 * JointTableRead(table, t + table.cols + 1))
+         / JOINT_TABLE_SCALE;
+  phi = (w00 * JointTableRead(table, p) + w10 * JointTableRead(table, p + 1)
+       + w01 * JointTableRead(table, p + table.cols) + w11 * JointTableRead(table, p + table.cols + 1))
+       / JOINT_TABLE_SCALE;
+}
+
+// Looks up the angles for (x, y). Returns false outside the area, just like CartesianTransfer.
+// The area is convex, so a cell with all four corners reachable is reachable everywhere. Every other cell is
+// flagged, which leaves the reach checks near the edge to CartesianTransfer itself.
+template <class Arm = KindLadyArm>
+inline bool JointTableTransfer(const JointTable& table, float x, float y, float& theta, float& phi) {
+  float gx = (x - table.x0) / table.step;
+  float gy = (y - table.y0) / table.step;
+  int col = (int)gx;
+  int row = (int)gy;
+  if (gx < 0 || gy < 0 || col >= table.cols - 1 || row >= table.rows - 1) {
+    return CartesianTransfer<Arm>(x, y, theta, phi);
+  }
+
+  int cell = row * (table.cols - 1) + col;
+  if (JointTableReadByte(table, table.fallback + cell / 8) & (1 << (cell % 8))) {
+    return CartesianTransfer<Arm>(x, y, theta, phi);
+  }
+
+  JointTableInterpolate(table, col, row, gx - col, gy - row, theta, phi);
+  return true;
+}
+
+// An angle in table units, false if it doesn't fit in an int16 (JOINT_TABLE_EMPTY is taken too)
+inline bool JointTableQuantise(float angle, int16_t& stored) {
+  long value = lroundf(angle * JOINT_TABLE_SCALE);
+  if (value <= INT16_MIN || value > INT16_MAX) {
+    return false;
+  }
+  stored = (int16_t)value;
+  return true;
+}
+
+// Fills a table in RAM. theta/phi need rows*cols entries and fallback needs JointTableFallbackBytes(cols, rows).
+// Every cell is checked at (samples+1) x (samples+1) points, edges included, against CartesianTransfer and gets
+// flagged if it is off by more than 90% of tolerance (rad) at any of them. The 10% is room for whatever peaks
+// between the sample points. Returns the worst error left in the cells that were not flagged.
+template <class Arm = KindLadyArm>
+inline float BuildJointTable(JointTable& table, int16_t* theta, int16_t* phi, uint8_t* fallback,
+                             float tolerance, int samples = 8) {
+  for (int row = 0; row < table.rows; row++) {
+    for (int col = 0; col < table.cols; col++) {
+      float t, p;
+      int i = row * table.cols + col;
+      if (!CartesianTransfer<Arm>(table.x0 + col * table.step, table.y0 + row * table.step, t, p) ||
+          !JointTableQuantise(t, theta[i]) || !JointTableQuantise(p, phi[i])) {
+        theta[i] = JOINT_TABLE_EMPTY;  // out of reach, or past what an int16 holds, either way its cells fall back
+        phi[i] = JOINT_TABLE_EMPTY;
+      }
+    }
+  }
+
+  table.theta = theta;
+  table.phi = phi;
+  table.fallback = fallback;
+  table.progmem = false;
+  for (int b = 0; b < JointTableFallbackBytes(table.cols, table.rows); b++) {
+    fallback[b] = 0;
+  }
+
+  float worst = 0;
+  for (int row = 0; row < table.rows - 1; row++) {
+    for (int col = 0; col < table.cols - 1; col++) {
+      int cell = row * (table.cols - 1) + col;
+      int i = row * table.cols + col;
+      bool flag = theta[i] == JOINT_TABLE_EMPTY || theta[i + 1] == JOINT_TABLE_EMPTY
+               || theta[i + table.cols] == JOINT_TABLE_EMPTY || theta[i + table.cols + 1] == JOINT_TABLE_EMPTY;
+
+      float cellWorst = 0;
+      for (int sy = 0; sy <= samples && !flag; sy++) {
+        for (int sx = 0; sx <= samples && !flag; sx++) {
+          float fx = (float)sx / samples;
+          float fy = (float)sy / samples;
+          float t, p, tt, pp;
+          CartesianTransfer<Arm>(table.x0 + (col + fx) * table.step, table.y0 + (row + fy) * table.step, t, p);
+          JointTableInterpolate(table, col, row, fx, fy, tt, pp);
+          cellWorst = fmaxf(cellWorst, fmaxf(fabsf(t - tt), fabsf(p - pp)));
+          flag = cellWorst > 0.9f * tolerance;
+        }
+      }
+
+      if (flag) {
+        fallback[cell / 8] |= 1 << (cell % 8);
+      }
+      else {
+        worst = fmaxf(worst, cellWorst);
+      }
+    }
+  }
+
+  table.max_error = worst;
+  return worst;
+}
@@ -0,0 +1,149 @@
+// Closed loop position control of one ScaraStepper from its own pot
+// ScaraStepper::Move takes a step whenever the pot isn't exactly on the goal, so it hunts round the goal forever and
+// at one speed. This runs a PID (plain P with the default gains) at a fixed CONTROL_HZ from the main loop instead.
+// Each update reads the pot, turns the error into a step rate and hands that period's worth of steps to a StepEngine,
+// which spreads them evenly over the period from its timer interrupt. The speed follows the error, and when the
+// steps happen doesn't depend on how long the rest of loop() takes.
+//   - inside the deadband the rate is 0 and the integral is cleared, which is what stops the hunting
+//   - the rate is capped at MAX_STEP_RATE and only changes by the motor's ProfileLimits accel (anything up to its
+//     start rate goes straight away), so the engine's own ramps are turned off for these blocks
+//   - the derivative is taken on the reading rather than the error, so moving the goal doesn't kick it
+//   - the integral stops adding up while the rate is capped, so it doesn't wind up on long moves
+// Fractions of a step are carried over to the next update.
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include "ScaraConfig.h"
+#include "StepEngine.h"
+
+struct ControlGains {
+  float kp, ki, kd;   // see CONTROL_KP, CONTROL_KI, CONTROL_KD
+  int deadband;       // pot counts
+};
+
+template <class Stepper = ScaraStepper>
+class PotControl {
+  private:
+  StepEngine<Stepper>* engine;
+  Stepper* stepper;
+  int motor;          // STEP_LEFT or STEP_RIGHT in the engine
+  ControlGains gains;
+
+  uint32_t period;    // us
+  uint32_t last;      // micros() the last update was due at
+  float integral;     // step seconds
+  float rate;         // steps/s, signed like ScaraStepper::Advance
+  float carry;        // part of a step not taken yet
+  float error;        // steps
+  int previous;       // reading at the last update
+
+  public:
+  PotControl(StepEngine<Stepper>& engine, int motor, Stepper& stepper) {
+    this->engine = &engine;
+    this->stepper = &stepper;
+    this->motor = motor;
+    this->gains.kp = CONTROL_KP;
+    this->gains.ki = CONTROL_KI;
+    this->gains.kd = CONTROL_KD;
+    this->gains.deadband = CONTROL_DEADBAND;
+    this->period = 1000000UL / CONTROL_HZ;
+    this->last = 0;
+    this->integral = 0;
+    this->rate = 0;
+    this->carry = 0;
+    this->error = 0;
+    this->previous = 0;
+  }
+
+  void setGains(const ControlGains& gains) {
+    this->gains = gains;
+  }
+
+  // Starts the control period from now, call once the engine is running
+  void Begin() {
+    this->stepper->readAngle();
+    this->previous = this->stepper->printAngle();
+    this->last = micros();
+  }
+
+  // Call every pass of loop(), runs the controller once a period has gone by and returns true if it did
+  bool Update() {
+    uint32_t now = micros();
+    if (now - this->last < this->period) {
+      return false;
+    }
+    this->last += this->period;
+    if (now - this->last >= this->period) {
+      this->last = now;  // more than a period behind, don't try to catch up
+    }
+    Control();
+    return true;
+  }
+
+  // One period of the controller, now. For callers that keep the period themselves (Scheduler.h) instead of Update.
+  void Control() {
+    const float dt = this->period / 1000000.0f;
+    const float stepsPerCount = STEPS_PER_RADIAN / POT_COUNTS_PER_RADIAN;
+    const ProfileLimits& limits = this->stepper->printProfile();
+
+    // Positive steps turn the pot down, same as Move
+    this->stepper->readAngle();
+    int reading = this->stepper->printAngle();
+    int counts = reading - this->stepper->printGoal();
+    this->error = counts * stepsPerCount;
+
+    float target = 0;
+    bool inside = counts <= this->gains.deadband && counts >= -this->gains.deadband;
+    if (inside) {
+      this->integral = 0;
+    }
+    else {
+      target = this->gains.kp * this->error + this->gains.ki * this->integral
+             + this->gains.kd * (reading - this->previous) * stepsPerCount / dt;
+    }
+    this->previous = reading;
+
+    bool capped = fabs(target) > MAX_STEP_RATE;
+    target = fmax(fmin(target, (float)MAX_STEP_RATE), -(float)MAX_STEP_RATE);
+    if (!inside && !capped) {
+      this->integral += this->error * dt;
+    }
+
+    // Acceleration limit, with a free jump anywhere the motor could start or stop at
+    float low = this->rate - limits.accel * dt;
+    float high = this->rate + limits.accel * dt;
+    if (fabs(this->rate) <= limits.start_rate) {
+      low = fmin(low, -limits.start_rate);
+      high = fmax(high, limits.start_rate);
+    }
+    this->rate = fmax(fmin(target, high), low);
+
+    if (this->rate == 0) {
+      this->carry = 0;
+      return;
+    }
+    this->carry += this->rate * dt;
+    int steps = (int)this->carry;
+    this->carry -= steps;
+    // A block per period keeps one running and one waiting, if the engine has fallen behind that these steps are
+    // dropped and the next reading makes up for them
+    if (steps != 0 && this->engine->Queued(this->motor) <= 1) {
+      this->engine->Push(this->motor, steps, this->period / (steps < 0 ? -steps : steps), false);
+    }
+  }
+
+  // Stops the motor where it is, Update starts it again
+  void Stop() {
+    this->engine->Stop(this->motor);
+    this->rate = 0;
+    this->carry = 0;
+    this->integral = 0;
+  }
+
+  float printRate() {
+    return this->rate;
+  }
+  float printError() {
+    return this->error;
+  }
+};
@@ -0,0 +1,280 @@
+// Pot readings taken in the background, so reading a pot is a couple of loads instead of a blocking analogRead
+// Every analogRead waits out a whole conversion (~110 us on an AVR), and each pass of loop() did four of them and got
+// whatever noise was on the pin at that instant. Here the ADC works through the added pins one after another on
+// its own, and each channel:
+//   - adds up POT_OVERSAMPLE conversions and keeps the average with POT_FRACTION_BITS more bits (decimation)
+//   - puts that in its ring buffer of the last POT_RING values
+//   - takes the median of the last POT_MEDIAN of them (0 or 1 turns it off), which gets rid of single spikes
+//   - runs that through a one pole IIR, y += (x - y) / 2^POT_IIR_SHIFT (0 turns it off), which smooths the rest
+// Read gives the latest filtered value without waiting.
+//
+// AVR: the ADC interrupt takes each result and starts the next conversion, clock / 128 so ~9600 conversions/s
+// shared between the channels. It owns the ADC while running, so every analog pin the sketch reads has to be added
+// (PotRead gives -1 for one that wasn't).
+// Teensy: an IntervalTimer every POT_SAMPLE_US does one analogRead (a few us on these). DMA through the ADC library
+// would take even that off the CPU, but it is one more dependency for little gain at these rates.
+// On the host (HalLinux.h) a virtual timer calls Poll every POT_SAMPLE_US, like the Teensy one.
+#pragma once
+#include <stdint.h>
+#include "Hal.h"
+#include "Instrument.h"
+#include "ScaraConfig.h"
+#include "Trace.h"
+
+#ifndef POT_CHANNELS
+#define POT_CHANNELS 4         // pins that can be added
+#endif
+#ifndef POT_RING
+#define POT_RING 8             // decimated values kept per channel, has to be a power of two and at least POT_MEDIAN
+#endif
+#ifndef POT_SAMPLE_US
+#define POT_SAMPLE_US 100      // Teensy and host, us between conversions
+#endif
+#define POT_FRACTION_BITS 4
+
+static_assert(POT_MEDIAN <= POT_RING, "POT_RING has to hold POT_MEDIAN values");
+
+class PotSampler {
+  private:
+  struct Channel {
+    uint8_t pin;
+    uint16_t sum;              // conversions so far towards the next value
+    uint8_t count;
+    uint16_t ring[POT_RING];   // decimated, in 1 / 2^POT_FRACTION_BITS counts
+    uint8_t head;
+    int32_t iir;               // filter state, 8 more bits again
+    volatile uint16_t value;   // filtered, in 1 / 2^POT_FRACTION_BITS counts
+    volatile uint16_t samples; // decimated values so far, wraps
+    uint8_t filled;            // same, but stops at POT_RING, so the filters only start over after Add
+  };
+  Channel channels[POT_CHANNELS];
+  uint8_t channel_count;
+  uint8_t current;             // channel the running conversion is for
+  bool running;
+
+  // One blocking conversion per channel, so Read has something to give before the first filtered value
+  void Prime() {
+    for (uint8_t i = 0; i < this->channel_count; i++) {
+      this->channels[i].value = analogRead(this->channels[i].pin) << POT_FRACTION_BITS;
+    }
+    this->current = 0;
+  }
+
+  uint16_t Median(const Channel& c) {
+    uint16_t sorted[POT_MEDIAN];
+    for (uint8_t i = 0; i < POT_MEDIAN; i++) {
+      uint16_t v = c.ring[(c.head - 1 - i) & (POT_RING - 1)];
+      uint8_t j = i;
+      for (; j > 0 && sorted[j - 1] > v; j--) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = v;
+    }
+    return sorted[POT_MEDIAN / 2];
+  }
+
+  void Filter(Channel& c, uint16_t decimated) {
+    c.ring[c.head] = decimated;
+    c.head = (c.head + 1) & (POT_RING - 1);
+    uint16_t x = decimated;
+#if POT_MEDIAN > 1
+    if (c.filled >= POT_MEDIAN - 1) {
+      x = Median(c);
+    }
+#endif
+#if POT_IIR_SHIFT > 0
+    if (c.filled == 0) {
+      c.iir = (int32_t)x << 8;  // start from the first value instead of creeping up from 0
+    }
+    c.iir += (((int32_t)x << 8) - c.iir) >> POT_IIR_SHIFT;
+    x = (uint16_t)((c.iir + 128) >> 8);
+#endif
+    c.value = x;
+    c.samples++;
+    if (c.filled < POT_RING) {
+      c.filled++;
+    }
+  }
+
+  public:
+  PotSampler() {
+    this->channel_count = 0;
+    this->current = 0;
+    this->running = false;
+  }
+
+  // Adds an analog pin before Begin, returns its channel or -1 if there are already POT_CHANNELS
+  int Add(uint8_t pin) {
+    if (this->channel_count == POT_CHANNELS || this->running) {
+      return -1;
+    }
+    Channel& c = this->channels[this->channel_count];
+    c.pin = pin;
+    c.sum = 0;
+    c.count = 0;
+    c.head = 0;
+    c.iir = 0;
+    c.samples = 0;
+    c.filled = 0;
+    c.value = 0;
+    return this->channel_count++;
+  }
+
+  // Channel a pin was added as, -1 if it wasn't
+  int Find(uint8_t pin) {
+    for (uint8_t i = 0; i < this->channel_count; i++) {
+      if (this->channels[i].pin == pin) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void Begin();
+  void End();
+
+  // One conversion result for the current channel, then on to the next one (the ADC interrupt calls this)
+  void Sample(uint16_t raw) {
+    Channel& c = this->channels[this->current];
+    c.sum += raw;
+    if (++c.count == POT_OVERSAMPLE) {
+      TRACE_EVENT(TRACE_ADC, this->current, (int16_t)((c.sum + POT_OVERSAMPLE / 2) / POT_OVERSAMPLE));
+      Filter(c, (uint16_t)(((uint32_t)c.sum << POT_FRACTION_BITS) / POT_OVERSAMPLE));
+      c.sum = 0;
+      c.count = 0;
+    }
+    this->current = this->current + 1 == this->channel_count ? 0 : this->current + 1;
+  }
+
+  // Where there is no ADC interrupt: one blocking conversion of the current channel
+  void Poll() {
+    if (this->channel_count > 0) {
+      INSTRUMENT_SCOPE("analogRead");
+      Sample(analogRead(this->channels[this->current].pin));
+    }
+  }
+
+  bool printRunning() {
+    return this->running;
+  }
+
+  // Pin of the channel the next conversion is for
+  uint8_t printPin() {
+    return this->channels[this->current].pin;
+  }
+
+  // Latest filtered value of a channel in pot counts, rounded
+  int Read(int channel) {
+    return (ReadFine(channel) + (1 << (POT_FRACTION_BITS - 1))) >> POT_FRACTION_BITS;
+  }
+
+  // Same in 1 / 2^POT_FRACTION_BITS counts
+  uint16_t ReadFine(int channel) {
+    InstrumentLock lock;
+    return this->channels[channel].value;
+  }
+
+  // Filtered values so far, to tell a new one from the last one (wraps at 65536)
+  uint16_t Samples(int channel) {
+    InstrumentLock lock;
+    return this->channels[channel].samples;
+  }
+
+  // The last decimated values before filtering, newest first, returns how many were copied
+  uint8_t History(int channel, uint16_t* values, uint8_t count) {
+    const Channel& c = this->channels[channel];
+    InstrumentLock lock;
+    if (count > c.filled) {
+      count = c.filled;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      values[i] = c.ring[(c.head - 1 - i) & (POT_RING - 1)];
+    }
+    return count;
+  }
+};
+
+PotSampler Pots;
+
+#if defined(TEENSYDUINO)
+IntervalTimer PotTimer;
+
+void PotSamplerInterrupt() {
+  Pots.Poll();
+}
+
+void PotSampler::Begin() {
+  if (this->channel_count > 0) {
+    Prime();
+    this->running = true;
+    PotTimer.begin(PotSamplerInterrupt, POT_SAMPLE_US);
+  }
+}
+
+void PotSampler::End() {
+  PotTimer.end();
+  this->running = false;
+}
+#elif defined(__AVR__)
+// ADMUX for a pin, AVcc reference like analogRead
+inline uint8_t PotMux(uint8_t pin) {
+  if (pin >= A0) {
+    pin -= A0;
+  }
+#if defined(analogPinToChannel)
+  pin = analogPinToChannel(pin);
+#endif
+  return _BV(REFS0) | (pin & 0x07);
+}
+
+ISR(ADC_vect) {
+  INSTRUMENT_SCOPE("adc isr");
+  Pots.Sample(ADC);
+  ADMUX = PotMux(Pots.printPin());
+  ADCSRA |= _BV(ADSC);
+}
+
+void PotSampler::Begin() {
+  if (this->channel_count > 0) {
+    Prime();
+    this->running = true;
+    ADMUX = PotMux(this->channels[0].pin);
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) | _BV(ADSC);  // clock / 128
+  }
+}
+
+void PotSampler::End() {
+  ADCSRA &= ~_BV(ADIE);
+  while (ADCSRA & _BV(ADSC)) {
+  }
+  this->running = false;
+}
+#else
+void PotSamplerInterrupt() {
+  Pots.Poll();
+}
+
+void PotSampler::Begin() {
+  if (this->channel_count > 0) {
+    Prime();
+    this->running = true;
+    HalTimerBegin(PotSamplerInterrupt, POT_SAMPLE_US);
+  }
+}
+
+void PotSampler::End() {
+  HalTimerEnd(PotSamplerInterrupt);
+  this->running = false;
+}
+#endif
+
+// A pot reading without waiting when the pin was added to Pots, a plain analogRead while Pots isn't running, and -1
+// for a pin that wasn't added once it is. Its interrupt or timer has the ADC then, and an analogRead in between
+// could pick up the other channel's conversion.
+inline int PotRead(uint8_t pin) {
+  int channel = Pots.Find(pin);
+  if (channel >= 0) {
+    return Pots.Read(channel);
+  }
+  return Pots.printRunning() ? -1 : analogRead(pin);
+}
@@ -0,0 +1,68 @@
+// Settings for the kind_lady arm and its two ScaraStepper motors
+// (Configuration.h and Configuration_adv.h are the Marlin settings this project started from, kept for reference)
+#pragma once
+#include <math.h>
+
+// Motors
+// A step is 1 / STEP_DIVISION of a full step: 1 full, 2 half, 4 8 or 16 PWM microsteps (Teensy only, see CoilTables.h).
+// Everything below that says steps means these steps, the rates are written in full steps and scaled.
+// With microsteps the rates can go past the 20 kHz StepEngine tick, which then caps them.
+#define STEP_DIVISION 1
+#define STEPS_PER_REV (200 * STEP_DIVISION)             // steps per motor revolution
+#define STEPS_PER_RADIAN (STEPS_PER_REV / 6.2831853f)
+#define START_STEP_RATE (400 * STEP_DIVISION)           // steps/s either motor can start or stop at without stalling
+#define MAX_STEP_RATE (1600 * STEP_DIVISION)            // steps/s either motor can reach with the ramps below
+#define MAX_ACCEL (4000L * STEP_DIVISION)               // steps/s^2
+#define MAX_JERK (80000L * STEP_DIVISION)               // steps/s^3
+// S-curve where there is an FPU. Its float divide per step costs ~50 us in an AVR's timer interrupt, a whole
+// STEP_TICK_US, so an Uno or Mega gets the trapezoid, which only needs an integer divide.
+#if defined(__AVR__)
+#define MOTION_PROFILE PROFILE_TRAPEZOID                // see StepProfile.h
+#else
+#define MOTION_PROFILE PROFILE_SCURVE                   // see StepProfile.h, Marlin's S_CURVE_ACCELERATION
+#endif
+
+// Potentiometers
+// reading = POT_CENTER with the arm pointing straight up (pi/2), POT_COUNTS_PER_RADIAN more per radian past that
+#define POT_CENTER 512
+#define POT_MAX 1023                                    // angles past either end of the pot can't be seen or reached
+#define POT_COUNTS_PER_RADIAN 195.4f                    // 10 bit ADC across a 300 degree pot
+// Background pot sampling (PotSampler.h)
+#define POT_OVERSAMPLE 16                               // conversions averaged per value, at most 64
+#define POT_MEDIAN 3                                    // values the median is taken over, 0 for none
+#define POT_IIR_SHIFT 2                                 // IIR weight 1 / 2^shift of each new value, 0 for none
+
+// Closed loop pot following (PotControl.h). The controller asks for a step rate from the pot error in steps:
+// rate = CONTROL_KP e + CONTROL_KI sum(e dt) + CONTROL_KD de/dt, capped at MAX_STEP_RATE and MAX_ACCEL
+#define CONTROL_HZ 100                                  // control updates per second
+#define CONTROL_KP 8.0f                                 // steps/s per step of error
+#define CONTROL_KI 0.0f                                 // steps/s per step second, 0 is plain P
+#define CONTROL_KD 0.0f                                 // s, the pots are noisy so leave it off unless filtered
+#define CONTROL_DEADBAND ((int)(POT_COUNTS_PER_RADIAN / STEPS_PER_RADIAN / 2) + 1)  // pot counts that count as there,
+                                                        // has to be over half a step or it hunts between two steps
+
+// Homing (Homing.h), steps are STEP_DIVISION steps like everything else
+#define HES_ACTIVE HIGH                                 // comparator output with the magnet over the HES
+#define HOMING_BLIND_STEPS (50 * STEP_DIVISION)         // the wrong way first, most that can get rammed
+#define HOMING_SEARCH_STEPS (200 * STEP_DIVISION)       // then back the other way, blind sweep included
+#define HOMING_FIELD_STEPS (20 * STEP_DIVISION)         // widest the HES field can be
+#define HOMING_FAST_US (1000000UL / START_STEP_RATE)    // us a step while hunting
+#define HOMING_SLOW_US (4 * HOMING_FAST_US)             // us a step through the field
+
+// Speed the tool is moved at, mm/s
+#define DEFAULT_FEEDRATE 50
+
+// Uncomment to time loop(), the interrupts and a few other things on the board and dump them over serial with a
+// '?' command frame, see Instrument.h. Costs a couple of cycle counter reads per scope, nothing at all when it's off.
+// #define INSTRUMENT
+// Same for keeping the last few thousand steps, pot values, queue pushes and pops and serial writes with their
+// times, sent on a 'T' command frame and turned into a Chrome/Perfetto trace by tools/TraceChrome.cpp, see Trace.h
+// #define TRACE
+
+inline float PotToAngle(int reading) {
+  return 1.5707963f + (reading - POT_CENTER) / POT_COUNTS_PER_RADIAN;
+}
+
+inline int AngleToPot(float angle) {
+  return POT_CENTER + (int)lroundf((angle - 1.5707963f) * POT_COUNTS_PER_RADIAN);
+}
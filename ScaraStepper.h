@@ -3,67 +3,52 @@ This is a modification and replacement of the standard arduino Stepper Library
 I am using a 4-pole stepper motor with a potentiometer coupled to it to relate the angle to a electrical signal
 
 */
+#pragma once
+#include "CoilPins.h"
+#include "CoilTables.h"
+#include "Instrument.h"
+#include "PotSampler.h"
+#include "ScaraConfig.h"
+#include "StepProfile.h"
 
 // Erik's Personal Stepper Class
-class ScaraStepper {
+// Coils says how the four coil pins get written (see CoilPins.h), ScaraStepper is the usual one
+template <class Coils>
+class BasicScaraStepper {
   private:
   //attachment pins
-  int motor_pin_a, motor_pin_b, motor_pin_c, motor_pin_d;
+  Coils coils;
   int pot_pin_a;
 
   //directional controls
   int reading; //potentiometer output
   int goal; // target angle
   int direction; //rotation direction (- cw, + ccw)
-  int step_number; //Stepper sequence
+  int step_number; //Stepper sequence, index into the CoilTables.h table
+  ProfileLimits profile; // how fast it can be ramped (StepEngine and CoordinatedMotion use it)
 
 void Step(){
-    switch (this->step_number) {
-      case 0:  // 1010
-        digitalWrite(motor_pin_a, HIGH);
-        digitalWrite(motor_pin_b, LOW);
-        digitalWrite(motor_pin_c, HIGH);
-        digitalWrite(motor_pin_d, LOW);
-      break;
-      case 1:  // 0110
-        digitalWrite(motor_pin_a, LOW);
-        digitalWrite(motor_pin_b, HIGH);
-        digitalWrite(motor_pin_c, HIGH);
-        digitalWrite(motor_pin_d, LOW);
-      break;
-      case 2:  //0101
-        digitalWrite(motor_pin_a, LOW);
-        digitalWrite(motor_pin_b, HIGH);
-        digitalWrite(motor_pin_c, LOW);
-        digitalWrite(motor_pin_d, HIGH);
-      break;
-      case 3:  //1001
-        digitalWrite(motor_pin_a, HIGH);
-        digitalWrite(motor_pin_b, LOW);
-        digitalWrite(motor_pin_c, LOW);
-        digitalWrite(motor_pin_d, HIGH);
-      break;
-    }
+#if defined(COIL_PWM)
+    this->coils.Pwm(COIL_TABLE_READ(CoilSine + ((this->step_number + STEP_DIVISION) & COIL_STEP_MASK)),
+                    COIL_TABLE_READ(CoilSine + this->step_number));
+#else
+    this->coils.Write(COIL_TABLE_READ_BYTE(CoilSequence + this->step_number));
+#endif
   }
   public:
   //Constructor
-  ScaraStepper(int motor_pin_a, int motor_pin_b, int motor_pin_c, int motor_pin_d,int pot_pin_a){
+  BasicScaraStepper(int motor_pin_a, int motor_pin_b, int motor_pin_c, int motor_pin_d,int pot_pin_a)
+    : coils(motor_pin_a, motor_pin_b, motor_pin_c, motor_pin_d) {
     // variable set-up
     this->step_number = 0;
     this->direction = 0;
+    this->profile.type = MOTION_PROFILE;
+    this->profile.start_rate = START_STEP_RATE;
+    this->profile.accel = MAX_ACCEL;
+    this->profile.jerk = MAX_JERK;
 
-    // pin control
-    this->motor_pin_a = motor_pin_a;
-    this->motor_pin_b = motor_pin_b;
-    this->motor_pin_c = motor_pin_c;
-    this->motor_pin_d = motor_pin_d;
+    // pin control (the coil pins are set up by coils)
     this->pot_pin_a = pot_pin_a;
-
-    // Pin Set-up
-    pinMode(this->motor_pin_a, OUTPUT);
-    pinMode(this->motor_pin_b, OUTPUT);
-    pinMode(this->motor_pin_c, OUTPUT);
-    pinMode(this->motor_pin_d, OUTPUT);
     pinMode(this->pot_pin_a, INPUT);
   }
 
@@ -71,41 +56,45 @@ void Step(){
   void setGoal(int goal){
     this->goal = goal;
   }
+  void setProfile(const ProfileLimits& profile){
+    this->profile = profile;
+  }
 
   // Updating and Moving the Stepper
   void Move(int wait){
+    INSTRUMENT_SCOPE("Move");  // delay(wait) included
     readAngle();
     this->direction = this->reading - this->goal;
+    Advance(this->direction);
+    delay(wait);
+  }
 
-    if (this->direction > 0) {
+  // One step in the direction of the sign (0 just re-energises the coils)
+  // Doesn't read the pot or wait, so the StepEngine timer interrupt can call it
+  void Advance(int direction){
+    if (direction > 0) {
       this->step_number++;
     }
-    else if (this->direction < 0){
+    else if (direction < 0){
       this->step_number--;
     }
-
-    if (this->step_number == 4){
-      this->step_number = 0;
-    }
-    else if (this->step_number == -1){
-      this->step_number = 3;
-    }
+    this->step_number &= COIL_STEP_MASK;  // -1 wraps round to the last state too
 
     Step();
-    delay(wait);
   }
 
   // Turning off the Stepper
   void Off() {
-    digitalWrite(motor_pin_a, LOW);
-    digitalWrite(motor_pin_b, LOW);
-    digitalWrite(motor_pin_c, LOW);
-    digitalWrite(motor_pin_d, LOW);
+#if defined(COIL_PWM)
+    this->coils.Pwm(0, 0);  // analogWrite 0 also lets go of the PWM timer
+#else
+    this->coils.Write(0);
+#endif
   }
 
-  //Read the current value
+  //Read the current value (filtered and without waiting if the pin was added to Pots)
   void readAngle() {
-    this->reading = analogRead(pot_pin_a);
+    this->reading = PotRead(pot_pin_a);
     }
   int printAngle() {
     return this->reading;
@@ -116,4 +105,13 @@ void Step(){
   int printStep() {
     return this->step_number;
   }
+  const ProfileLimits& printProfile() {
+    return this->profile;
+  }
 };
+
+typedef BasicScaraStepper<DefaultCoils> ScaraStepper;
+
+// Same thing with the coil pins fixed at compile time, e.g. FixedScaraStepper<3,5,4,6> LeftMotor(3,5,4,6,A0);
+template <int PinA, int PinB, int PinC, int PinD>
+using FixedScaraStepper = BasicScaraStepper<FixedCoils<PinA, PinB, PinC, PinD> >;
@@ -0,0 +1,163 @@
+// Cooperative scheduler for the main loop: each job gets its own fixed period instead of running once per loop()
+// Stepping isn't one of the jobs. StepEngine and CoordinatedMotion already step from a timer interrupt, which is
+// the only way steps keep their timing whatever the main loop is doing. This is for everything around them:
+// reading the goals, planning or closed loop control, telemetry. Run() goes in loop() and runs whichever tasks are
+// due, in the order they were added (so add the ones that matter most first). A task is released every period us,
+// its due time moving on by exactly one period each time so it never drifts, and period 0 runs it on every pass.
+// Nothing preempts anything, so a task that takes long makes the others late, which is what the counters show:
+//   late      us after its due time it got to start, the jitter. Worst and a running mean (last ~16 runs).
+//   time      us it took, worst
+//   overruns  releases it missed entirely because the next one was already due by the time it started. Those are
+//             skipped rather than run back to back to catch up.
+// Dump prints them as text, which the sketch does on a '?' command frame along with the Instrument.h scopes.
+#pragma once
+#include <stdint.h>
+#include "Hal.h"
+
+#ifndef SCHEDULER_TASKS
+#define SCHEDULER_TASKS 8
+#endif
+#define SCHEDULER_MEAN_SHIFT 4  // late mean over about 2^4 runs
+
+struct SchedulerTask {
+  const char* name;
+  void (*run)();
+  uint32_t period;     // us, 0 for every pass
+  uint32_t due;        // micros()
+  uint32_t runs;
+  uint16_t overruns;
+  uint32_t late_max;   // us
+  uint32_t late_mean;  // us << SCHEDULER_MEAN_SHIFT
+  uint32_t time_max;   // us
+};
+
+template <uint8_t Size = SCHEDULER_TASKS>
+class Scheduler {
+  private:
+  SchedulerTask tasks[Size];
+  uint8_t count;
+
+  public:
+  Scheduler() {
+    this->count = 0;
+  }
+
+  // Index of the new task, -1 if there's no room for it
+  int Add(const char* name, void (*run)(), uint32_t period) {
+    if (this->count == Size) {
+      return -1;
+    }
+    SchedulerTask& task = this->tasks[this->count];
+    task.name = name;
+    task.run = run;
+    task.period = period;
+    task.due = 0;
+    task.runs = 0;
+    task.overruns = 0;
+    task.late_max = 0;
+    task.late_mean = 0;
+    task.time_max = 0;
+    return this->count++;
+  }
+
+  // First release of every task is one period from now
+  void Begin() {
+    uint32_t now = micros();
+    for (uint8_t i = 0; i < this->count; i++) {
+      this->tasks[i].due = now + this->tasks[i].period;
+    }
+  }
+
+  // Call every pass of loop()
+  void Run() {
+    for (uint8_t i = 0; i < this->count; i++) {
+      SchedulerTask& task = this->tasks[i];
+      uint32_t start = micros();
+      uint32_t late = 0;
+      if (task.period != 0) {
+        late = start - task.due;
+        if ((int32_t)late < 0) {
+          continue;
+        }
+        if (late >= task.period) {
+          uint32_t missed = late / task.period;
+          task.overruns += missed;
+          task.due += missed * task.period;
+          late -= missed * task.period;
+        }
+        task.due += task.period;
+      }
+
+      task.run();
+
+      uint32_t time = micros() - start;
+      task.runs++;
+      if (late > task.late_max) {
+        task.late_max = late;
+      }
+      task.late_mean += late - (task.late_mean >> SCHEDULER_MEAN_SHIFT);
+      if (time > task.time_max) {
+        task.time_max = time;
+      }
+    }
+  }
+
+  // Clears every task's counters, the tasks and their due times stay
+  void Reset() {
+    for (uint8_t i = 0; i < this->count; i++) {
+      SchedulerTask& task = this->tasks[i];
+      task.runs = 0;
+      task.overruns = 0;
+      task.late_max = 0;
+      task.late_mean = 0;
+      task.time_max = 0;
+    }
+  }
+
+  // A line per task: name runs overruns, then late max, late mean and time max in us
+  template <class Out>
+  void Dump(Out& out) {
+    out.println();  // off the end of whatever binary came before, so the header starts a line
+    out.print("# scheduler, us, runs overruns late max, late mean, time max");
+    out.println();
+    for (uint8_t i = 0; i < this->count; i++) {
+      out.print(printName(i));
+      out.print(' ');
+      out.print((unsigned long)printRuns(i));
+      out.print(' ');
+      out.print((unsigned int)printOverruns(i));
+      out.print(' ');
+      out.print((unsigned long)printLateMax(i));
+      out.print(' ');
+      out.print((unsigned long)printLateMean(i));
+      out.print(' ');
+      out.print((unsigned long)printTimeMax(i));
+      out.println();
+    }
+    out.print("# end");
+    out.println();
+  }
+
+  uint8_t Count() {
+    return this->count;
+  }
+
+  const char* printName(uint8_t i) {
+    return this->tasks[i].name;
+  }
+  uint32_t printRuns(uint8_t i) {
+    return this->tasks[i].runs;
+  }
+  uint16_t printOverruns(uint8_t i) {
+    return this->tasks[i].overruns;
+  }
+  uint32_t printLateMax(uint8_t i) {
+    return this->tasks[i].late_max;
+  }
+  uint32_t printLateMean(uint8_t i) {
+    return this->tasks[i].late_mean >> SCHEDULER_MEAN_SHIFT;
+  }
+  uint32_t printTimeMax(uint8_t i) {
+    return this->tasks[i].time_max;
+  }
+};
@@ -0,0 +1,236 @@
+// Timer interrupt stepping for the two ScaraSteppers, so neither motor waits on the other or on the main loop
+// The main loop queues blocks of "this many steps, this far apart" per motor with Push, and a hardware timer
+// ticking every STEP_TICK_US works through them: each motor counts down its own interval and steps when it runs
+// out, so both arms move at the same time at independent rates. Intervals are kept in microseconds and carried
+// over between ticks, so the average rate is exact and any single step is at most one tick late.
+// Blocks faster than the motor's start rate are ramped up and down with its ProfileLimits (StepProfile.h), so each
+// block starts and ends at the start rate and a short one may not reach the rate it asked for.
+// Each motor's blocks wait in a StepRing, so Push never has to turn interrupts off.
+//
+// Timers: IntervalTimer on the Teensy, Timer1 (CTC on OCR1A) on the AVR boards, which rules out the Servo library.
+// On the host (HalLinux.h) it is a virtual timer that ticks as virtual time passes, and Tick() can be called directly.
+#pragma once
+#include <stdint.h>
+#include "ScaraStepper.h"
+#include "StepRing.h"
+#include "Trace.h"
+
+#ifndef STEP_TICK_US
+#define STEP_TICK_US 50        // 20 kHz, the fastest interval that still gets resolved to within 2%
+#endif
+#ifndef STEP_QUEUE_SIZE
+#define STEP_QUEUE_SIZE 16     // default ring size per motor, has to be a power of two
+#endif
+
+#define STEP_LEFT 0
+#define STEP_RIGHT 1
+#define STEP_BLOCK_MAX 32767   // most steps either way in one block or segment, they are kept in an int16_t
+
+// Interrupts off and back to how they were, not just on, so these are safe where they are already off.
+// LOCK declares a local, so keep both in the same block.
+#if defined(TEENSYDUINO)
+#define STEP_ENGINE_LOCK() uint32_t step_engine_primask; \
+  __asm__ volatile("mrs %0, primask" : "=r"(step_engine_primask)); __disable_irq()
+#define STEP_ENGINE_UNLOCK() if (!(step_engine_primask & 1)) __enable_irq()
+#elif defined(ARDUINO)
+#define STEP_ENGINE_LOCK() uint8_t step_engine_sreg = SREG; cli()
+#define STEP_ENGINE_UNLOCK() SREG = step_engine_sreg
+#else
+#define STEP_ENGINE_LOCK()
+#define STEP_ENGINE_UNLOCK()
+#endif
+
+// What the timer interrupt calls. Whoever drives the motors (StepEngine, CoordinatedMotion) starts the timer
+// with their own tick, only one of them can own it at a time.
+void (*StepEngineTick)() = 0;
+
+#if defined(TEENSYDUINO)
+IntervalTimer StepTimer;
+
+void StepEngineInterrupt() {
+  StepEngineTick();
+}
+#elif defined(__AVR__)
+ISR(TIMER1_COMPA_vect) {
+  StepEngineTick();
+}
+#endif
+
+inline void StepTimerBegin(void (*tick)()) {
+  StepEngineTick = tick;
+#if defined(TEENSYDUINO)
+  StepTimer.begin(StepEngineInterrupt, STEP_TICK_US);
+#elif defined(__AVR__)
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);  // CTC, clock / 8
+  TCNT1 = 0;
+  OCR1A = (uint16_t)(F_CPU / 8 / 1000000UL * STEP_TICK_US - 1);
+  TIMSK1 |= _BV(OCIE1A);
+  interrupts();
+#else
+  HalTimerBegin(tick, STEP_TICK_US);
+#endif
+}
+
+inline void StepTimerEnd() {
+#if defined(TEENSYDUINO)
+  StepTimer.end();
+#elif defined(__AVR__)
+  TIMSK1 &= ~_BV(OCIE1A);
+#else
+  HalTimerEnd(StepEngineTick);
+#endif
+}
+
+// steps are signed with the same sense as ScaraStepper::Advance, 0 steps just waits out one interval
+struct StepBlock {
+  int16_t steps;
+  uint16_t ramp;      // steps spent speeding up (and slowing down), from PlanRamp
+  uint32_t interval;  // us between steps once up to speed
+};
+
+// Stepper is ScaraStepper or any other BasicScaraStepper, QueueSize is the ring size per motor
+template <class Stepper = ScaraStepper, uint8_t QueueSize = STEP_QUEUE_SIZE>
+class StepEngine {
+  private:
+  struct Channel {
+    Stepper* motor;
+    StepRing<StepBlock, QueueSize> queue;
+    int16_t remaining;          // of the running block, signed
+    bool running;
+    StepProfile profile;        // intervals of the running block
+    int32_t due;                // us until the next step
+    volatile int32_t position;  // steps taken since Begin, signed
+  };
+  Channel channels[2];
+
+  void Service(Channel& c) {
+    if (!c.running) {
+      StepBlock block;
+      if (!c.queue.Take(block)) {
+        return;
+      }
+      TRACE_EVENT(TRACE_POP, TRACE_QUEUE_LEFT + (&c - this->channels), c.queue.Count());
+      c.remaining = block.steps;
+      c.profile.Start(c.motor->printProfile(), block.steps < 0 ? -block.steps : block.steps, block.ramp,
+                      block.interval);
+      c.due = c.profile.Next();
+      c.running = true;
+    }
+
+    c.due -= STEP_TICK_US;
+    if (c.due > 0) {
+      return;
+    }
+    if (c.remaining > 0) {
+      c.motor->Advance(1);
+      c.position++;
+      c.remaining--;
+      TRACE_EVENT(TRACE_STEP, &c - this->channels, (int16_t)c.position);
+    }
+    else if (c.remaining < 0) {
+      c.motor->Advance(-1);
+      c.position--;
+      c.remaining++;
+      TRACE_EVENT(TRACE_STEP, &c - this->channels, (int16_t)c.position);
+    }
+    if (c.remaining == 0) {
+      c.running = false;
+    }
+    else {
+      c.due += c.profile.Next();
+    }
+  }
+
+  static StepEngine* active;  // the one the timer interrupt runs
+
+  static void Interrupt() {
+    INSTRUMENT_SCOPE("step isr");
+    active->Tick();
+  }
+
+  public:
+  StepEngine(Stepper& left, Stepper& right) {
+    this->channels[STEP_LEFT].motor = &left;
+    this->channels[STEP_RIGHT].motor = &right;
+    for (int i = 0; i < 2; i++) {
+      this->channels[i].remaining = 0;
+      this->channels[i].running = false;
+      this->channels[i].due = 0;
+      this->channels[i].position = 0;
+    }
+  }
+
+  // Starts the timer
+  void Begin() {
+    active = this;
+    StepTimerBegin(Interrupt);
+  }
+
+  void End() {
+    StepTimerEnd();
+  }
+
+  // Queues a block for one motor, false if its queue is full or steps is past STEP_BLOCK_MAX either way (split it
+  // up). Only call from the main loop.
+  // interval is the rate to cruise at, the ramps either side of it make the block take longer than steps * interval.
+  // ramp = false runs every step at interval, for callers that keep the rate smooth themselves (PotControl).
+  bool Push(int motor, int steps, uint32_t interval, bool ramp = true) {
+    Channel& c = this->channels[motor];
+    if (steps > STEP_BLOCK_MAX || steps < -STEP_BLOCK_MAX || c.queue.Free() == 0) {
+      return false;
+    }
+    float rate = 1000000.0f / (interval < STEP_TICK_US ? STEP_TICK_US : interval);
+    StepBlock block;
+    block.steps = steps;
+    block.ramp = ramp ? PlanRamp(c.motor->printProfile(), steps < 0 ? -steps : steps, rate) : 0;
+    block.interval = (uint32_t)(1000000.0f / rate);
+    if (!c.queue.Push(block)) {
+      return false;
+    }
+    TRACE_EVENT(TRACE_PUSH, TRACE_QUEUE_LEFT + motor, c.queue.Count());
+    return true;
+  }
+
+  // Blocks waiting for a motor, not counting the one it is on
+  int Queued(int motor) {
+    return this->channels[motor].queue.Count();
+  }
+
+  bool Idle(int motor) {
+    return Queued(motor) == 0 && !this->channels[motor].running;
+  }
+
+  // Drops everything still queued for a motor and stops it where it is
+  void Stop(int motor) {
+    STEP_ENGINE_LOCK();
+    this->channels[motor].queue.Clear();
+    this->channels[motor].running = false;
+    STEP_ENGINE_UNLOCK();
+  }
+
+  // One timer tick, called from the interrupt
+  void Tick() {
+    Service(this->channels[STEP_LEFT]);
+    Service(this->channels[STEP_RIGHT]);
+  }
+
+  long printPosition(int motor) {
+    STEP_ENGINE_LOCK();
+    long position = this->channels[motor].position;
+    STEP_ENGINE_UNLOCK();
+    return position;
+  }
+
+  // How far ahead the main loop keeps a motor, see StepRing.h
+  uint8_t printHighWatermark(int motor) {
+    return this->channels[motor].queue.printHighWatermark();
+  }
+  uint16_t printUnderruns(int motor) {
+    return this->channels[motor].queue.printUnderruns();
+  }
+};
+
+template <class Stepper, uint8_t QueueSize>
+StepEngine<Stepper, QueueSize>* StepEngine<Stepper, QueueSize>::active = 0;
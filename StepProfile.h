@@ -0,0 +1,177 @@
+// Acceleration ramps for a block of steps, worked out one step at a time inside the timer interrupt
+// A stepper can only start (and stop) at the rate it can pull in from standstill, START_STEP_RATE. Anything faster
+// has to be ramped up to and back down from, which is what lets MAX_STEP_RATE sit well above it.
+//   PROFILE_CONSTANT   every step at the block's interval, the old behaviour
+//   PROFILE_TRAPEZOID  constant acceleration. D. Austin's recurrence (Atmel AVR446) gives the next interval from
+//                      the last one with one integer divide: c(n) = c(n-1) - 2 c(n-1) / (4n + 1), where n counts
+//                      steps from standstill. Starting at START_STEP_RATE just means starting at n0 = v0^2 / 2a.
+//   PROFILE_SCURVE     jerk limited (Marlin's S_CURVE_ACCELERATION). Acceleration and rate are integrated per step
+//                      with dt = 1/v: a += j dt, v += a dt. The acceleration starts coming back down when the rate
+//                      left to gain is a^2 / 2j, so it reaches zero just as the rate reaches the cruise rate.
+//                      One float divide per step, so it is meant for the Teensy. On an AVR it takes ~50 us every
+//                      step, which makes that timer tick late, so ScaraConfig.h leaves AVRs on the trapezoid.
+// Neither needs a sqrt per step. PlanRamp does the few that are needed once per block, in the main loop.
+// The way down is the way up backwards, starting when there are as many steps left as the way up took.
+#pragma once
+#include <math.h>
+#include <stdint.h>
+
+#define PROFILE_CONSTANT 0
+#define PROFILE_TRAPEZOID 1
+#define PROFILE_SCURVE 2
+
+// Per motor limits, all in steps
+struct ProfileLimits {
+  uint8_t type;       // PROFILE_...
+  float start_rate;   // steps/s the motor can start and stop at
+  float accel;        // steps/s^2
+  float jerk;         // steps/s^3, S-curve only
+};
+
+// Steps the ramp from start_rate up to rate takes
+inline float RampSteps(const ProfileLimits& limits, float rate) {
+  if (rate <= limits.start_rate || limits.type == PROFILE_CONSTANT) {
+    return 0;
+  }
+  if (limits.type == PROFILE_TRAPEZOID) {
+    return (rate * rate - limits.start_rate * limits.start_rate) / (2 * limits.accel);
+  }
+  // S-curve: symmetric in time, so the average rate is the middle one. Short ramps never reach full acceleration.
+  float gain = rate - limits.start_rate;
+  float seconds = gain * limits.jerk >= limits.accel * limits.accel
+                ? gain / limits.accel + limits.accel / limits.jerk
+                : 2 * sqrt(gain / limits.jerk);
+  return (rate + limits.start_rate) / 2 * seconds;
+}
+
+// Works out the ramp for a block of steps meant to run at rate (steps/s). If the block is too short to get up to
+// rate and back down again, rate is lowered to what it can reach. Returns the number of steps the ramp up takes.
+inline uint16_t PlanRamp(const ProfileLimits& limits, uint16_t steps, float& rate) {
+  if (limits.type == PROFILE_CONSTANT || rate <= limits.start_rate) {
+    return 0;
+  }
+  if (RampSteps(limits, rate) * 2 > steps) {
+    if (limits.type == PROFILE_TRAPEZOID) {
+      rate = sqrt(limits.start_rate * limits.start_rate + limits.accel * steps);
+    }
+    else {
+      float low = limits.start_rate, high = rate;
+      for (int i = 0; i < 16; i++) {
+        float middle = (low + high) / 2;
+        if (RampSteps(limits, middle) * 2 > steps) {
+          high = middle;
+        }
+        else {
+          low = middle;
+        }
+      }
+      rate = low;
+    }
+  }
+  uint16_t ramp = (uint16_t)(RampSteps(limits, rate) + 0.5f);
+  return ramp * 2 > steps ? steps / 2 : ramp;
+}
+
+// Runs one block: Start with what PlanRamp gave, then Next before every step for the interval leading up to it
+class StepProfile {
+  private:
+  ProfileLimits limits;
+  uint16_t steps, ramp, step;
+  uint32_t cruise;     // us
+
+  // Trapezoid, all in whole us with the remainder carried like AVR446
+  uint32_t interval;
+  int32_t rest;
+  int32_t count;       // n in the recurrence, negative on the way down
+  int32_t first;       // n at start_rate
+
+  // S-curve
+  float rate, accel, top;
+
+  // One step of the recurrence at the current count, with the remainder carried so it doesn't drift
+  void Austin() {
+    int32_t divisor = 4 * this->count + 1;
+    int32_t twice = (int32_t)(2 * this->interval) + this->rest;
+    this->interval -= twice / divisor;
+    this->rest = twice % divisor;
+  }
+
+  public:
+  StepProfile() {
+    this->limits.type = PROFILE_CONSTANT;
+    this->steps = this->ramp = this->step = 0;
+    this->cruise = this->interval = 0;
+  }
+
+  void Start(const ProfileLimits& limits, uint16_t steps, uint16_t ramp, uint32_t cruise) {
+    this->limits = limits;
+    this->steps = steps;
+    this->ramp = ramp;
+    this->step = 0;
+    this->cruise = cruise;
+    if (ramp == 0) {
+      this->limits.type = PROFILE_CONSTANT;
+    }
+    this->interval = (uint32_t)(1000000.0f / limits.start_rate);
+    this->rest = 0;
+    this->first = (int32_t)(limits.start_rate * limits.start_rate / (2 * limits.accel));
+    this->count = this->first;
+    this->rate = limits.start_rate;
+    this->accel = 0;
+    this->top = 1000000.0f / cruise;
+  }
+
+  // us before the next step
+  uint32_t Next() {
+    uint16_t step = this->step++;
+    if (this->limits.type == PROFILE_CONSTANT) {
+      return this->cruise;
+    }
+    if (step == 0) {
+      return this->interval;
+    }
+    uint16_t down = this->steps - this->ramp;  // first step of the way down
+
+    if (this->limits.type == PROFILE_TRAPEZOID) {
+      if (step < down) {
+        if (step <= this->ramp) {
+          this->count++;
+          Austin();
+          if (this->interval < this->cruise) {
+            this->interval = this->cruise;
+          }
+        }
+      }
+      else if (step == down) {
+        // Same interval as the last one up, then back through the same n's: c(n-1) = c(n) - 2c(n) / (-4n + 1)
+        this->count = -this->count;
+        this->rest = 0;
+      }
+      else if (this->count < -this->first) {
+        Austin();
+        this->count++;
+      }
+      return this->interval;
+    }
+
+    // S-curve, the acceleration ramps towards limits.accel and eases off in time to land on the target rate
+    if (step == down) {
+      this->accel = 0;  // both ways start from zero acceleration
+    }
+    float dt = 1.0f / this->rate;
+    float left = step >= down ? this->rate - this->limits.start_rate : this->top - this->rate;
+    if (left <= this->accel * this->accel / (2 * this->limits.jerk)) {
+      this->accel = fmax(this->accel - this->limits.jerk * dt, 0.0f);
+    }
+    else {
+      this->accel = fmin(this->accel + this->limits.jerk * dt, this->limits.accel);
+    }
+    if (step >= down) {
+      this->rate = fmax(this->rate - this->accel * dt, this->limits.start_rate);
+    }
+    else {
+      this->rate = fmin(this->rate + this->accel * dt, this->top);
+    }
+    return (uint32_t)(dt * 1000000.0f);
+  }
+};
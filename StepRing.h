@@ -0,0 +1,104 @@
+// Single producer, single consumer ring of step blocks between the main loop and the step interrupt
+// The main loop only ever writes head and the interrupt only ever writes tail, both single bytes, so neither side
+// has to turn interrupts off to hand a block over. The block is copied in before head moves and out before tail
+// moves, with a compiler barrier in between so the copy can't be reordered past the index update.
+// Size is a power of two and the ring holds Size - 1 blocks.
+//
+// Two counters say whether the planner keeps ahead of the motors:
+//   high watermark  most blocks that were ever waiting, right after a Push
+//   underruns       times the interrupt came for a block, found none, and had been busy until then. The end of every
+//                   move counts too, so what matters is whether it goes up in the middle of a long streamed one.
+#pragma once
+#include <stdint.h>
+
+#define STEP_RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+template <class Block, uint8_t Size>
+class StepRing {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "StepRing size has to be a power of two");
+
+  private:
+  Block blocks[Size];
+  volatile uint8_t head;        // next free slot, written by the producer
+  volatile uint8_t tail;        // next block to take, written by the consumer
+  uint8_t high_watermark;       // producer side
+  volatile uint16_t underruns;  // consumer side
+  bool starved;                 // consumer side, found it empty last time
+
+  public:
+  StepRing() {
+    this->head = 0;
+    this->tail = 0;
+    this->high_watermark = 0;
+    this->underruns = 0;
+    this->starved = true;  // nothing to underrun before the first block
+  }
+
+  // Producer: copies a block in, false if the ring is full
+  bool Push(const Block& block) {
+    uint8_t head = this->head;
+    uint8_t next = (head + 1) & (Size - 1);
+    if (next == this->tail) {
+      return false;
+    }
+    this->blocks[head] = block;
+    STEP_RING_BARRIER();
+    this->head = next;
+    uint8_t count = Count();
+    if (count > this->high_watermark) {
+      this->high_watermark = count;
+    }
+    return true;
+  }
+
+  // Consumer: copies the oldest block out, false if there isn't one
+  bool Take(Block& block) {
+    uint8_t tail = this->tail;
+    if (tail == this->head) {
+      if (!this->starved) {
+        this->underruns++;
+        this->starved = true;
+      }
+      return false;
+    }
+    STEP_RING_BARRIER();
+    block = this->blocks[tail];
+    STEP_RING_BARRIER();
+    this->tail = (tail + 1) & (Size - 1);
+    this->starved = false;
+    return true;
+  }
+
+  // Blocks waiting, either side can ask
+  uint8_t Count() {
+    return (this->head - this->tail) & (Size - 1);
+  }
+
+  uint8_t Free() {
+    return Size - 1 - Count();
+  }
+
+  bool Empty() {
+    return this->head == this->tail;
+  }
+
+  // Drops everything waiting. This moves tail from the producer side, so the consumer can't be running meanwhile
+  // (interrupts off, or its timer stopped).
+  void Clear() {
+    this->tail = this->head;
+    this->starved = true;
+  }
+
+  uint8_t printHighWatermark() {
+    return this->high_watermark;
+  }
+
+  // Read until two reads agree, so a 16 bit count can't be torn by the interrupt on an AVR
+  uint16_t printUnderruns() {
+    uint16_t underruns;
+    do {
+      underruns = this->underruns;
+    } while (underruns != this->underruns);
+    return underruns;
+  }
+};
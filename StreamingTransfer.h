@@ -0,0 +1,157 @@
+// Warm-started CartesianTransfer for dense toolpaths
+// Consecutive points are microns apart, so the previous answer is already almost right. Keeping the tool on the
+// end of each distal link means |P - E1(theta)|^2 = B^2 and |P - E2(phi)|^2 = D^2, and each of those only depends
+// on one motor angle. A Newton step on each one is a handful of multiplies and a divide:
+//   theta += r1 / (2 k1) with r1 = |P - E1|^2 - B^2 and k1 = (P - E1) . dE1/dtheta (same k as in Jacobian)
+// The elbow directions (cos, sin) are carried along and turned by each small angle change instead of calling
+// cos/sin again. Anything that doesn't settle quickly goes back to the closed form:
+//   - the first point, or a jump longer than max_step
+//   - an elbow close to straight (k small), where Newton stops converging and the reach check matters
+//   - a leftover link length error above tolerance after two steps
+// Rounding makes the carried (cos, sin) and the angle itself wander apart over many points, so every
+// STREAMING_RESYNC points (cos, sin) are worked out from the angle again.
+// Speed on the host (tools/BenchStreamingIK.cpp, best of 9): ~1.6x the closed form at 0.01 to 0.1 mm between
+// points, about even at 0.2 mm, and slower from 0.5 mm on, where it takes the second Newton step or falls back more
+// often. It hasn't been timed on a board.
+#pragma once
+#include "CoordinateTransfer.h"
+
+#ifndef STREAMING_RESYNC
+#define STREAMING_RESYNC 256
+#endif
+
+template <class Arm = KindLadyArm>
+class StreamingTransfer {
+  private:
+  float x, y;                 // last point solved
+  float theta, phi;           // and its angles
+  float cos_theta, sin_theta; // elbow directions
+  float cos_phi, sin_phi;
+  bool primed;                // false until there is a previous point to start from
+  int since_resync;
+
+  float max_step;  // mm
+  float tolerance; // mm of link length error
+  unsigned long fallbacks;
+
+  bool Closed(float x, float y) {
+    this->fallbacks++;
+    if (!CartesianTransfer<Arm>(x, y, this->theta, this->phi)) {
+      this->primed = false;
+      return false;
+    }
+    this->x = x;
+    this->y = y;
+    this->cos_theta = cos(this->theta);
+    this->sin_theta = sin(this->theta);
+    this->cos_phi = cos(this->phi);
+    this->sin_phi = sin(this->phi);
+    this->primed = true;
+    this->since_resync = 0;
+    return true;
+  }
+
+  // Turns (c, s) by a small angle d, good to d^3/6, and pulls it back onto the unit circle
+  static void Turn(float& c, float& s, float d) {
+    float half = 1 - d*d/2;
+    float nc = c*half - s*d;
+    float ns = s*half + c*d;
+    float fix = (3 - (nc*nc + ns*ns)) / 2;
+    c = nc * fix;
+    s = ns * fix;
+  }
+
+  public:
+  StreamingTransfer(float max_step = 1.0f, float tolerance = 0.0005f) {
+    this->max_step = max_step;
+    this->tolerance = tolerance;
+    this->fallbacks = 0;
+    this->primed = false;
+    this->since_resync = 0;
+    this->x = 0;
+    this->y = 0;
+  }
+
+  // Same as CartesianTransfer(x, y, theta, phi)
+  bool Next(float x, float y, float& theta, float& phi) {
+    float dx = x - this->x;
+    float dy = y - this->y;
+    if (!this->primed || y < Arm::MinY || dx*dx + dy*dy > this->max_step * this->max_step) {
+      bool valid = Closed(x, y);
+      theta = this->theta;
+      phi = this->phi;
+      return valid;
+    }
+
+    // Elbows only get close to straight next to the edge of the area, 0.1 is about 6 degrees from straight
+    const float leftLimit = 0.1f * Arm::A * Arm::B;
+    const float rightLimit = 0.1f * Arm::C * Arm::D;
+    const float leftTolerance = 2 * Arm::B * this->tolerance;
+    const float rightTolerance = 2 * Arm::D * this->tolerance;
+
+    float t = this->theta, p = this->phi;
+    float ct = this->cos_theta, st = this->sin_theta;
+    float cp = this->cos_phi, sp = this->sin_phi;
+    bool settled = false;
+
+    for (int i = 0; i < 3; i++) {
+      float u1x = x - Arm::A * ct;
+      float u1y = y - Arm::A * st;
+      float u2x = x - Arm::Base - Arm::C * cp;
+      float u2y = y - Arm::C * sp;
+      float r1 = u1x*u1x + u1y*u1y - Arm::B * Arm::B;
+      float r2 = u2x*u2x + u2y*u2y - Arm::D * Arm::D;
+      if (fabs(r1) <= leftTolerance && fabs(r2) <= rightTolerance) {
+        settled = true;
+        break;
+      }
+
+      float k1 = Arm::A * (u1y * ct - u1x * st);
+      float k2 = Arm::C * (u2y * cp - u2x * sp);
+      if (fabs(k1) < leftLimit || fabs(k2) < rightLimit) {
+        break;
+      }
+
+      float d1 = r1 / (2 * k1);
+      float d2 = r2 / (2 * k2);
+      t += d1;
+      p += d2;
+      Turn(ct, st, d1);
+      Turn(cp, sp, d2);
+    }
+
+    if (!settled) {
+      bool valid = Closed(x, y);
+      theta = this->theta;
+      phi = this->phi;
+      return valid;
+    }
+
+    this->x = x;
+    this->y = y;
+    this->theta = theta = t;
+    this->phi = phi = p;
+    this->cos_theta = ct;
+    this->sin_theta = st;
+    this->cos_phi = cp;
+    this->sin_phi = sp;
+
+    if (++this->since_resync >= STREAMING_RESYNC) {
+      this->cos_theta = cos(t);
+      this->sin_theta = sin(t);
+      this->cos_phi = cos(p);
+      this->sin_phi = sin(p);
+      this->since_resync = 0;
+    }
+    return true;
+  }
+
+  // Forget the previous point, the next one goes through the closed form
+  void Restart() {
+    this->primed = false;
+  }
+
+  unsigned long printFallbacks() {
+    return this->fallbacks;
+  }
+};
@@ -0,0 +1,121 @@
+// Binary telemetry frames out of the serial port, instead of printing the readings as text every loop
+// Printing four numbers as text every pass of loop() waits on the serial port whenever its 64 byte buffer is full,
+// which at 19200 baud holds loop() to about a hundred passes a second. Here the sketch sends a frame every
+// TELEMETRY_US (a Scheduler.h task), as 26 bytes copied into a TX ring, and Drain() only hands Serial as many bytes
+// as it has room for right now, so neither ever waits. If the ring hasn't room for a whole frame the frame is
+// dropped (and counted), and since every frame made gets the next sequence number the gap shows up at the other
+// end too.
+// tools/TelemetryDecode.cpp turns a capture of the stream back into CSV or one file per column.
+//
+// On the wire a frame is the TelemetryFrame struct as it is in memory, little endian (AVR, ARM and x86 all are):
+//   A5 5A | sequence u16 | time u32 (micros) | angle i16 x2 | goal i16 x2 | steps i32 x2 | crc u16
+// The CRC is CRC-16/XMODEM (polynomial 0x1021, starting at 0) of everything from the sync bytes up to it.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "Hal.h"
+#include "StepRing.h"
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+#ifndef TELEMETRY_US
+#define TELEMETRY_US 20000UL   // 50 frames a second, 1300 bytes/s, a tenth of 115200 baud
+#endif
+#ifndef TELEMETRY_BUFFER
+#define TELEMETRY_BUFFER 128   // TX ring in bytes, has to be a power of two
+#endif
+#define TELEMETRY_SYNC 0x5AA5  // A5 then 5A on the wire
+
+struct __attribute__((packed)) TelemetryFrame {
+  uint16_t sync;
+  uint16_t sequence;   // one more every frame made, sent or not
+  uint32_t time;       // micros() when it was made
+  int16_t angle[2];    // motor pot readings, left then right
+  int16_t goal[2];     // goal pot readings
+  int32_t steps[2];    // step positions of the motors
+  uint16_t crc;
+};
+
+static_assert(sizeof(TelemetryFrame) == 26, "TelemetryFrame has to be packed");
+
+inline uint16_t TelemetryCrc(const uint8_t* data, size_t length) {
+  uint16_t crc = 0;
+  for (size_t i = 0; i < length; i++) {
+#if defined(__AVR__)
+    crc = _crc_xmodem_update(crc, data[i]);
+#else
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+#endif
+  }
+  return crc;
+}
+
+class TelemetryLink {
+  private:
+  StepRing<uint8_t, TELEMETRY_BUFFER> tx;  // filled by Send, emptied by Drain, both from the main loop
+  uint16_t sequence;
+  uint16_t dropped;
+
+  public:
+  TelemetryLink() {
+    this->sequence = 0;
+    this->dropped = 0;
+  }
+
+  // Fills in sync, sequence, time and crc and queues the frame, false if it was dropped for want of room
+  bool Send(TelemetryFrame& frame) {
+    frame.sync = TELEMETRY_SYNC;
+    frame.sequence = this->sequence++;
+    frame.time = micros();
+    frame.crc = TelemetryCrc((const uint8_t*)&frame, offsetof(TelemetryFrame, crc));
+    if (!Queue((const uint8_t*)&frame, sizeof(frame))) {
+      this->dropped++;
+      return false;
+    }
+    return true;
+  }
+
+  // Queues any other frame to go out between telemetry frames (XYStream's acks), whole or not at all
+  bool Queue(const uint8_t* bytes, uint8_t length) {
+    if (this->tx.Free() < length) {
+      return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+      this->tx.Push(bytes[i]);
+    }
+    return true;
+  }
+
+  // Gives Serial what it can take without waiting, call it every pass of loop(). Returns how many bytes that was.
+  int Drain() {
+    int room = Serial.availableForWrite();
+    int sent = 0;
+    uint8_t byte;
+    while (sent < room && this->tx.Take(byte)) {
+      Serial.write(byte);
+      sent++;
+    }
+    return sent;
+  }
+
+  // Waits until everything queued has gone to Serial, so whatever is written straight to Serial next comes after
+  // whole frames rather than in the middle of one
+  void Flush() {
+    uint8_t byte;
+    while (this->tx.Take(byte)) {
+      Serial.write(byte);
+    }
+  }
+
+  uint16_t printDropped() {
+    return this->dropped;
+  }
+
+  uint16_t printSequence() {
+    return this->sequence;
+  }
+};
@@ -0,0 +1,153 @@
+// A ring of the last TRACE_SIZE timestamped events, to see what happened when rather than how long things took
+// Instrument.h keeps totals. This keeps every step, pot value, HES edge, motion/waypoint queue push and pop and
+// serial write as it happens, overwriting the oldest, so the last fraction of a second before something went wrong
+// (one motor stalling while the other carries on, a queue running dry, telemetry holding up the loop) can be
+// looked at event by event. Recording is a micros() and 8 bytes with interrupts off, from anywhere.
+//   step    motor, its position after the step (low 16 bits)
+//   adc     pot channel (PotSampler), the averaged value in counts, one per POT_OVERSAMPLE conversions
+//   hes     HES pin, the level Homing just found it at
+//   push    queue (TRACE_QUEUE_*), what's in it after
+//   pop     queue, what's left in it
+//   tx      bytes handed to Serial in one go
+// A 'T' command frame over serial (XYStream.h, the sketch's Command) sends the ring as binary frames, oldest first,
+// then an end frame.
+// Recording stops while it does that so the ring holds still. tools/TraceChrome.cpp turns a capture with those
+// frames in it into Chrome trace JSON for chrome://tracing or ui.perfetto.dev.
+//
+// On the wire, little endian like Telemetry.h and with the same CRC-16/XMODEM:
+//   A8 5A | first u32 (number of the first event, counting from Begin) | count u8 | count x event | crc u16
+//   event:  time u32 (micros) | type u8 | arg u8 | value i16
+// The end frame has count 0 and first is the number of events recorded in all, so how many got overwritten shows.
+//
+// Only there with TRACE defined (ScaraConfig.h, or -DTRACE on the host), TRACE_EVENT is empty without it.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Hal.h"
+#include "Instrument.h"
+#include "ScaraConfig.h"
+#include "Telemetry.h"
+
+#define TRACE_STEP 1
+#define TRACE_ADC 2
+#define TRACE_HES 3
+#define TRACE_PUSH 4
+#define TRACE_POP 5
+#define TRACE_TX 6
+
+#define TRACE_QUEUE_MOTION 0      // CoordinatedMotion's segments
+#define TRACE_QUEUE_LEFT 1        // StepEngine's blocks, TRACE_QUEUE_LEFT + motor
+#define TRACE_QUEUE_RIGHT 2
+#define TRACE_QUEUE_WAYPOINTS 3   // XYStream
+
+#define TRACE_SYNC 0x5AA8         // A8 then 5A
+#define TRACE_BATCH 8             // events a frame
+
+struct __attribute__((packed)) TraceRecord {
+  uint32_t time;  // micros()
+  uint8_t type;   // TRACE_STEP ...
+  uint8_t arg;
+  int16_t value;
+};
+
+struct __attribute__((packed)) TraceHeader {
+  uint16_t sync;
+  uint32_t first;
+  uint8_t count;
+};
+
+#define TRACE_FRAME_MAX (sizeof(TraceHeader) + TRACE_BATCH * sizeof(TraceRecord) + 2)
+
+#if defined(TRACE)
+
+#ifndef TRACE_SIZE
+#if defined(__AVR__)
+#define TRACE_SIZE 32             // events kept, has to be a power of two. An Uno has 2 KB of RAM all told.
+#else
+#define TRACE_SIZE 4096
+#endif
+#endif
+
+class TraceRing {
+  private:
+  TraceRecord events[TRACE_SIZE];
+  uint32_t recorded;  // events so far, the next one goes in at recorded % TRACE_SIZE
+  bool frozen;
+
+  public:
+  TraceRing() {
+    this->recorded = 0;
+    this->frozen = false;
+  }
+
+  void Record(uint8_t type, uint8_t arg, int16_t value) {
+    InstrumentLock lock;
+    if (this->frozen) {
+      return;
+    }
+    TraceRecord& event = this->events[this->recorded++ & (TRACE_SIZE - 1)];
+    event.time = micros();
+    event.type = type;
+    event.arg = arg;
+    event.value = value;
+  }
+
+  // Sends everything in the ring, oldest first, then the end frame. Waits on port the whole way.
+  template <class Port>
+  void Dump(Port& port) {
+    uint32_t end;
+    {
+      InstrumentLock lock;
+      this->frozen = true;
+      end = this->recorded;
+    }
+    uint32_t first = end > TRACE_SIZE ? end - TRACE_SIZE : 0;
+    uint8_t frame[TRACE_FRAME_MAX];
+    while (true) {
+      TraceHeader header;
+      header.sync = TRACE_SYNC;
+      header.first = first;
+      header.count = end - first < TRACE_BATCH ? end - first : TRACE_BATCH;
+      memcpy(frame, &header, sizeof(header));
+      uint8_t length = sizeof(header);
+      for (uint8_t i = 0; i < header.count; i++) {
+        memcpy(frame + length, &this->events[(first + i) & (TRACE_SIZE - 1)], sizeof(TraceRecord));
+        length += sizeof(TraceRecord);
+      }
+      uint16_t crc = TelemetryCrc(frame, length);
+      memcpy(frame + length, &crc, 2);
+      port.write(frame, length + 2);
+      if (header.count == 0) {
+        break;
+      }
+      first += header.count;
+    }
+    InstrumentLock lock;
+    this->frozen = false;
+  }
+
+  uint32_t printRecorded() {
+    InstrumentLock lock;
+    return this->recorded;
+  }
+};
+
+TraceRing Trace;
+
+#define TRACE_EVENT(type, arg, value) Trace.Record(type, arg, value)
+
+template <class Port>
+void TraceDump(Port& port) {
+  Trace.Dump(port);
+}
+
+#else
+
+#define TRACE_EVENT(type, arg, value)
+
+template <class Port>
+void TraceDump(Port&) {
+}
+
+#endif
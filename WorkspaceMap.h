@@ -0,0 +1,140 @@
+// Raster of the workspace so moves can be checked before they are queued instead of failing in CartesianTransfer
+// tools/WorkspaceMapGen.cpp builds it offline. Each cell is one byte: 0 when any part of the cell is out of reach,
+// otherwise the top speed the tool can be moved at in any direction anywhere in the cell, in units of speed_scale.
+// Looking up a point is one divide per axis and one byte read, cheap enough to check every move as it is queued.
+//
+// The top speed comes from the inverse Jacobian. Each motor turns at (u . v) / k (see Jacobian), so the worst
+// direction gives |v| = omega * k / |u|, and |u| is just the distal link length. With both motors capped at
+// MAX_STEP_RATE that is min(k1 / B, k2 / D) * MAX_STEP_RATE / STEPS_PER_RADIAN, which drops to 0 at full reach.
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "CoordinateTransfer.h"
+#include "ScaraConfig.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#endif
+
+struct WorkspaceMap {
+  float x0, y0;       // corner of cell (0,0) in mm
+  float step;         // cell size in mm
+  float speed_scale;  // mm/s per count
+  uint16_t cols, rows;
+  const uint8_t* cells;  // rows * cols, row major
+  bool progmem;          // cells are in flash (the generated header), not RAM. Only matters on AVR.
+};
+
+inline uint8_t WorkspaceRead(const WorkspaceMap& map, int i) {
+#if defined(__AVR__)
+  if (map.progmem) {
+    return (uint8_t)pgm_read_byte(map.cells + i);
+  }
+#endif
+  return map.cells[i];
+}
+
+// Blob layout: "KLWM", uint16 version, uint16 cols, uint16 rows, float x0, y0, step, speed_scale, then the cells
+#define WORKSPACE_MAP_HEADER 26
+
+// Points a map at a blob written by WorkspaceMapGen --binary, loaded into RAM. False if it isn't one.
+inline bool WorkspaceMapFromBlob(const uint8_t* blob, WorkspaceMap& map) {
+  if (blob[0] != 'K' || blob[1] != 'L' || blob[2] != 'W' || blob[3] != 'M' || blob[4] != 1 || blob[5] != 0) {
+    return false;
+  }
+  memcpy(&map.cols, blob + 6, 2);
+  memcpy(&map.rows, blob + 8, 2);
+  memcpy(&map.x0, blob + 10, 4);
+  memcpy(&map.y0, blob + 14, 4);
+  memcpy(&map.step, blob + 18, 4);
+  memcpy(&map.speed_scale, blob + 22, 4);
+  map.cells = blob + WORKSPACE_MAP_HEADER;
+  map.progmem = false;
+  return true;
+}
+
+// Top speed in mm/s at (x, y), 0 if it can't be reached
+inline float WorkspaceSpeed(const WorkspaceMap& map, float x, float y) {
+  float gx = (x - map.x0) / map.step;
+  float gy = (y - map.y0) / map.step;
+  if (gx < 0 || gy < 0 || gx >= map.cols || gy >= map.rows) {
+    return 0;
+  }
+  return WorkspaceRead(map, (int)gy * map.cols + (int)gx) * map.speed_scale;
+}
+
+inline bool WorkspaceReachable(const WorkspaceMap& map, float x, float y) {
+  return WorkspaceSpeed(map, x, y) > 0;
+}
+
+// How much of the straight move from (x0, y0) to (x1, y1) stays in reach, 0..1
+// Walks the line in half-cell steps, so it costs one lookup per half cell of travel.
+inline float WorkspaceClip(const WorkspaceMap& map, float x0, float y0, float x1, float y1) {
+  float length = sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0));
+  int steps = (int)(2 * length / map.step) + 1;
+  for (int i = 0; i <= steps; i++) {
+    float f = (float)i / steps;
+    if (!WorkspaceReachable(map, x0 + (x1-x0)*f, y0 + (y1-y0)*f)) {
+      return i == 0 ? 0 : (float)(i - 1) / steps;
+    }
+  }
+  return 1;
+}
+
+// What the generator measures at one point
+struct WorkspacePoint {
+  bool reachable;
+  float theta, phi;   // motor angles, rad
+  float singularity;  // mm to the nearest place the arm can't be driven through (full reach or the y guard)
+  float speed;        // mm/s in the worst direction
+};
+
+template <class Arm>
+WorkspacePoint MeasureWorkspace(float x, float y) {
+  WorkspacePoint point = {false, 0, 0, 0, 0};
+  if (!CartesianTransfer<Arm>(x, y, point.theta, point.phi)) {
+    return point;
+  }
+  point.reachable = true;
+
+  float s1 = sqrt(x*x + y*y);
+  float s2 = sqrt((x-Arm::Base)*(x-Arm::Base) + y*y);
+  point.singularity = fmin(fmin(Arm::LeftReach - s1, Arm::RightReach - s2), y - Arm::MinY);
+
+  float ct = cos(point.theta), st = sin(point.theta);
+  float cp = cos(point.phi), sp = sin(point.phi);
+  float u1x = x - Arm::A * ct;
+  float u1y = y - Arm::A * st;
+  float u2x = x - Arm::Base - Arm::C * cp;
+  float u2y = y - Arm::C * sp;
+  float k1 = Arm::A * (u1y * ct - u1x * st);
+  float k2 = Arm::C * (u2y * cp - u2x * sp);
+  point.speed = fmin(fabs(k1) / Arm::B, fabs(k2) / Arm::D) * MAX_STEP_RATE / STEPS_PER_RADIAN;
+  return point;
+}
+
+// Fills rows [first, last) of a map. Each cell takes the worst of its four corners, the area is convex so a cell
+// with all corners in reach is in reach everywhere. Separate row ranges can be filled from separate threads.
+template <class Arm>
+void BuildWorkspaceRows(const WorkspaceMap& map, uint8_t* cells, int first, int last) {
+  for (int row = first; row < last; row++) {
+    for (int col = 0; col < map.cols; col++) {
+      float slowest = INFINITY;
+      for (int corner = 0; corner < 4; corner++) {
+        WorkspacePoint point = MeasureWorkspace<Arm>(map.x0 + (col + (corner & 1)) * map.step,
+                                                     map.y0 + (row + (corner >> 1)) * map.step);
+        slowest = point.reachable ? fmin(slowest, point.speed) : 0;
+        if (slowest == 0) {
+          break;
+        }
+      }
+      // Reachable cells never round down to 0
+      float counts = slowest / map.speed_scale;
+      cells[row * map.cols + col] = slowest == 0 ? 0 : (uint8_t)fmax(1.0f, fmin(255.0f, counts));
+    }
+  }
+}
@@ -0,0 +1,246 @@
+// XY waypoints streamed in over serial, with credits so the sender keeps the queue full but never overfills it
+// The sender (tools/XYSend.cpp) sends frames of up to XY_BATCH waypoints, every waypoint numbered by counting from
+// the first one it ever sent. The sketch takes them out of the queue one at a time, through CartesianTransfer and
+// into CoordinatedMotion. Every so often it answers with an ack saying how many waypoints it has accepted so far
+// and how much room is left, which is the sender's credit, much like Marlin's ADVANCED_OK: the sender only ever
+// has as many waypoints in flight as the board has said it has room for. Frames with a bad CRC, or that don't
+// start at the next waypoint (one before them was lost), are dropped whole. The acks keep saying where the board
+// is up to, so when the sender hears no progress for a while it goes back and resends from there.
+//
+// On the wire, little endian like Telemetry.h and with the same CRC-16/XMODEM:
+//   sender:  A6 5A | first u16 | count u8 | count x (x i16, y i16 in 0.1 mm, feed u16 mm/s) | crc u16
+//   board:   A7 5A | next u16 | free u8 | rejected u8 | crc u16
+// The acks go out through the TelemetryLink ring between telemetry frames, so a decoder of either can skip the other.
+// The sender can also send a command for the sketch (like '?' for the Instrument.h counters) in a frame of its own,
+//   sender:  A9 5A | command u8 | crc u16
+// so a stray byte, or what's left of a waypoint frame after a receive overrun, can't be taken for one.
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Hal.h"
+#include "StepRing.h"
+#include "Telemetry.h"
+#include "Trace.h"
+
+#ifndef XY_QUEUE_SIZE
+#define XY_QUEUE_SIZE 32       // waypoint ring on the board, has to be a power of two
+#endif
+#define XY_BATCH 4             // most waypoints in a frame
+#define XY_SYNC 0x5AA6         // A6 then 5A
+#define XY_ACK_SYNC 0x5AA7     // A7 then 5A
+#define XY_COMMAND_SYNC 0x5AA9 // A9 then 5A
+#define XY_ACK_MIN_US 5000UL   // acks at most this often, they share the port with telemetry
+#define XY_ACK_US 100000UL     // and at least this often, so a sender that starts late still hears where it's at
+
+struct __attribute__((packed)) XYWaypoint {
+  int16_t x, y;     // 0.1 mm, in CartesianTransfer's frame
+  uint16_t feed;    // mm/s on the way to it, 0 for DEFAULT_FEEDRATE
+};
+
+struct __attribute__((packed)) XYHeader {
+  uint16_t sync;
+  uint16_t first;   // number of the first waypoint in the frame
+  uint8_t count;    // 1 to XY_BATCH
+};
+
+struct __attribute__((packed)) XYAck {
+  uint16_t sync;
+  uint16_t next;      // number of the next waypoint it will accept, everything before that is in
+  uint8_t free;       // room for that many more
+  uint8_t rejected;   // waypoints CartesianTransfer couldn't reach, counting up (and wrapping)
+  uint16_t crc;
+};
+
+struct __attribute__((packed)) XYCommand {
+  uint16_t sync;
+  uint8_t command;
+  uint16_t crc;
+};
+
+#define XY_FRAME_MAX (sizeof(XYHeader) + XY_BATCH * sizeof(XYWaypoint) + 2)
+
+inline XYCommand XYCommandFrame(uint8_t command) {
+  XYCommand frame;
+  frame.sync = XY_COMMAND_SYNC;
+  frame.command = command;
+  frame.crc = TelemetryCrc((const uint8_t*)&frame, offsetof(XYCommand, crc));
+  return frame;
+}
+
+// Picks command frames out of a byte stream. XYStream hands it the bytes between waypoint frames, a sketch without
+// one can give it everything that comes in.
+class XYCommandReader {
+  private:
+  uint8_t frame[sizeof(XYCommand)];
+  uint8_t have;  // bytes of frame read so far
+  int command;   // last good one, -1 for none
+
+  public:
+  XYCommandReader() {
+    this->have = 0;
+    this->command = -1;
+  }
+
+  // Takes the next byte, false if it isn't part of a command frame
+  bool Read(uint8_t c) {
+    if (this->have == 0) {
+      this->have = c == (XY_COMMAND_SYNC & 0xff);
+      this->frame[0] = c;
+      return this->have;
+    }
+    if (this->have == 1 && c != (XY_COMMAND_SYNC >> 8)) {
+      this->have = 0;
+      return Read(c);
+    }
+    this->frame[this->have++] = c;
+    if (this->have == sizeof(XYCommand)) {
+      XYCommand command;
+      memcpy(&command, this->frame, sizeof(command));
+      if (command.crc == TelemetryCrc(this->frame, offsetof(XYCommand, crc))) {
+        this->command = command.command;
+      }
+      this->have = 0;
+    }
+    return true;
+  }
+
+  // The last command that came in, -1 if none came since the last call. Only the last one is kept.
+  int Command() {
+    int command = this->command;
+    this->command = -1;
+    return command;
+  }
+};
+
+class XYStream {
+  private:
+  StepRing<XYWaypoint, XY_QUEUE_SIZE> queue;
+  uint8_t frame[XY_FRAME_MAX];
+  uint8_t have;       // bytes of frame read so far
+  uint16_t next;
+  uint8_t rejected;
+  uint16_t bad;
+  bool ack_due;
+  uint32_t last_ack;  // micros()
+  XYCommandReader commands;
+
+  void Accept(uint8_t length) {
+    uint16_t crc;
+    memcpy(&crc, this->frame + length - 2, 2);
+    XYHeader header;
+    memcpy(&header, this->frame, sizeof(header));
+    this->ack_due = true;
+    if (crc != TelemetryCrc(this->frame, length - 2) || header.first != this->next ||
+        header.count > this->queue.Free()) {
+      this->bad++;
+      return;
+    }
+    for (uint8_t i = 0; i < header.count; i++) {
+      XYWaypoint waypoint;
+      memcpy(&waypoint, this->frame + sizeof(header) + i * sizeof(XYWaypoint), sizeof(waypoint));
+      this->queue.Push(waypoint);
+    }
+    TRACE_EVENT(TRACE_PUSH, TRACE_QUEUE_WAYPOINTS, this->queue.Count());
+    this->next += header.count;
+  }
+
+  public:
+  XYStream() {
+    this->have = 0;
+    this->next = 0;
+    this->rejected = 0;
+    this->bad = 0;
+    this->ack_due = true;
+    this->last_ack = 0;
+  }
+
+  // Reads whatever has come in, call every pass of loop()
+  void Poll() {
+    while (Serial.available() > 0) {
+      uint8_t c = Serial.read();
+      if (this->have == 0) {
+        if (this->commands.Read(c)) {
+          continue;
+        }
+        this->have = c == (XY_SYNC & 0xff);
+        this->frame[0] = c;
+        continue;
+      }
+      if (this->have == 1) {
+        this->have = c == (XY_SYNC >> 8) ? 2 : c == (XY_SYNC & 0xff);
+        this->frame[1] = c;
+        continue;
+      }
+      this->frame[this->have++] = c;
+      if (this->have < sizeof(XYHeader)) {
+        continue;
+      }
+      uint8_t count = this->frame[offsetof(XYHeader, count)];
+      if (count == 0 || count > XY_BATCH) {
+        this->have = 0;
+        this->bad++;
+        continue;
+      }
+      uint8_t length = sizeof(XYHeader) + count * sizeof(XYWaypoint) + 2;
+      if (this->have == length) {
+        Accept(length);
+        this->have = 0;
+      }
+    }
+  }
+
+  // Queues an ack on the link if one is due, call every pass of loop() after Poll
+  void Ack(TelemetryLink& link) {
+    uint32_t now = micros();
+    uint32_t since = now - this->last_ack;
+    if (!(this->ack_due && since >= XY_ACK_MIN_US) && since < XY_ACK_US) {
+      return;
+    }
+    XYAck ack;
+    ack.sync = XY_ACK_SYNC;
+    ack.next = this->next;
+    ack.free = this->queue.Free();
+    ack.rejected = this->rejected;
+    ack.crc = TelemetryCrc((const uint8_t*)&ack, offsetof(XYAck, crc));
+    if (link.Queue((const uint8_t*)&ack, sizeof(ack))) {
+      this->ack_due = false;
+      this->last_ack = now;
+    }
+  }
+
+  // Oldest waypoint waiting, false if there's none. Taking one frees a credit.
+  bool Take(XYWaypoint& waypoint) {
+    if (!this->queue.Take(waypoint)) {
+      return false;
+    }
+    TRACE_EVENT(TRACE_POP, TRACE_QUEUE_WAYPOINTS, this->queue.Count());
+    this->ack_due = true;
+    return true;
+  }
+
+  // For a waypoint that was taken but couldn't be reached, the sender hears about it in the next ack
+  void Reject() {
+    this->rejected++;
+    this->ack_due = true;
+  }
+
+  // The last command frame's command (like the sketch's '?'), -1 if none came since the last call
+  int Command() {
+    return this->commands.Command();
+  }
+
+  uint8_t Waiting() {
+    return this->queue.Count();
+  }
+
+  uint16_t printNext() {
+    return this->next;
+  }
+  uint8_t printRejected() {
+    return this->rejected;
+  }
+  uint16_t printBad() {
+    return this->bad;
+  }
+};
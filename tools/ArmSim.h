@@ -0,0 +1,255 @@
+// Physics of the two motors, their arms, pots and HES, run in virtual time behind Hal.h's Linux backend
+// Each motor is read off its coil pins the way the real one is driven, so whatever the sketch headers do (full,
+// half or microsteps, ramps, homing) reaches the rotor through the same pins:
+//   - the coil currents give a field angle and strength (PWM duty counts as that fraction of the current)
+//   - torque on the rotor is K(w) sin(field - rotor) in electrical angle, with K falling off with speed like
+//     K(w) = hold / sqrt(1 + (w / corner)^2) to stand in for the coil inductance and back EMF
+//   - less Coulomb and viscous friction, damping on the rotor's speed relative to the field, and detent torque
+//   - integrated every SIM_DT_US with the arm's inertia on the rotor
+// Nothing decides that a step was missed: overdrive it and the rotor falls behind by a whole electrical turn on
+// its own, which printMissed reports (4 full steps at a time). Hard stops (where one arm runs into the other) stop
+// the rotor dead, and with linkage on, moves the five bar can't close are refused the same way.
+// Pots read AngleToPot of the arm angle plus noise, clamped to the ADC range. The HES field is a bell around
+// hes_angle, and the comparator switches on above hes_on and off below hes_off.
+//
+// Positive steps (Advance(1)) turn the pot down, so the arm angle is start - theta like ScaraStepper::Move expects.
+// Only one ArmSim can run at a time, it hooks HalAnalogSource, HalDigitalSource and a HAL timer.
+#pragma once
+#include <math.h>
+#include <random>
+
+#include "../Hal.h"
+#include "../ScaraConfig.h"
+#include "../CoilTables.h"
+#include "../CoordinateTransfer.h"
+
+#ifndef SIM_DT_US
+#define SIM_DT_US 20
+#endif
+#define SIM_POLE_PAIRS (STEPS_PER_REV / STEP_DIVISION / 4)  // electrical turns per rotor turn
+
+struct MotorModel {
+  float hold;          // N m holding torque with both coils fully on
+  float corner;        // rad/s where the torque is down to 1/sqrt(2)
+  float inertia;       // kg m^2, rotor plus arm
+  float friction;      // N m, Coulomb
+  float viscous;       // N m s
+  float damping;       // N m s, on the speed relative to the field
+  float detent;        // N m
+};
+
+// Small 200 step motor through an L293 at 12 V with a light printed arm on it. Pulls in to about 600 steps/s
+// from rest and runs to about 2400 steps/s with a ramp at the default MAX_ACCEL. The damping hasn't been measured
+// on the real motors and the results depend on it: at about a third of it the minor axis of a CoordinatedMotion
+// segment (whose steps come unevenly, see Bresenham) and the homing sweeps start to miss steps. SimScenarios
+// sweeps it down and fails unless everything still passes at half.
+inline MotorModel DefaultMotorModel() {
+  MotorModel model = {0.3f, 10.0f, 2.0e-5f, 0.015f, 2.0e-4f, 2.0e-3f, 0.005f};
+  return model;
+}
+
+class ArmSim {
+  public:
+  struct Motor {
+    uint8_t coil[4];     // pin_a..pin_d like ScaraStepper
+    uint8_t pot;         // analog pin
+    uint8_t hes;         // digital pin, 0 for none
+    MotorModel model;
+    double start;        // arm angle at theta = 0, rad
+    double low, high;    // hard stops, arm angle
+    double theta, omega; // rotor, rad from start and rad/s
+    double field;        // field angle, electrical and unwrapped
+    double field_speed;  // rad/s electrical, smoothed
+    bool hes_on;
+  };
+
+  Motor motors[2];
+  float pot_noise;       // counts rms
+  float hes_angle;       // rad
+  float hes_width;       // rad, where the field is down to 1/e
+  float hes_on, hes_off; // comparator thresholds, fraction of the peak
+  bool linkage;          // refuse moves where ForwardTransfer fails
+  long blocked;          // ticks a hard stop or the linkage held a rotor
+
+  ArmSim(uint32_t seed = 1) : rng(seed), noise(0.0f, 1.0f) {
+    const uint8_t coils[2][4] = {{3, 5, 4, 6}, {7, 9, 8, 10}};
+    const uint8_t pots[2] = {A0, A1};
+    for (int m = 0; m < 2; m++) {
+      Motor& motor = this->motors[m];
+      for (int i = 0; i < 4; i++) {
+        motor.coil[i] = coils[m][i];
+      }
+      motor.pot = pots[m];
+      motor.hes = 0;
+      motor.model = DefaultMotorModel();
+      motor.start = 1.5707963;
+      motor.low = -1e9;
+      motor.high = 1e9;
+    }
+    this->pot_noise = 0.5f;
+    this->hes_angle = 4.712389f;  // 270 degrees
+    this->hes_width = 0.05f;
+    this->hes_on = 0.6f;
+    this->hes_off = 0.4f;
+    this->linkage = true;
+  }
+
+  // Puts both rotors at rest on their start angles (on a full step) and hooks into the HAL, after HalReset
+  void Begin() {
+    for (int m = 0; m < 2; m++) {
+      Motor& motor = this->motors[m];
+      motor.theta = 0;
+      motor.omega = 0;
+      motor.field = M_PI / 4;  // coil state 0, where the rotor is
+      motor.field_speed = 0;
+      motor.hes_on = false;
+      UpdateHes(motor);
+    }
+    this->blocked = 0;
+    active = this;
+    HalAnalogSource = AnalogSource;
+    HalDigitalSource = DigitalSource;
+    HalTimerBegin(Interrupt, SIM_DT_US);
+  }
+
+  void End() {
+    HalTimerEnd(Interrupt);
+    HalAnalogSource = 0;
+    HalDigitalSource = 0;
+  }
+
+  // Both motors' damping times factor, after the constructor
+  void ScaleDamping(float factor) {
+    for (int m = 0; m < 2; m++) {
+      this->motors[m].model.damping *= factor;
+    }
+  }
+
+  double printAngle(int m) {
+    return this->motors[m].start - this->motors[m].theta;
+  }
+
+  // Steps per second the rotor is turning at, positive like Advance
+  double printSpeed(int m) {
+    return this->motors[m].omega * STEPS_PER_RADIAN;
+  }
+
+  // Steps the rotor is behind the coils by, in whole electrical turns. 0 unless a step was missed.
+  long printMissed(int m) {
+    const Motor& motor = this->motors[m];
+    double rotor = SIM_POLE_PAIRS * motor.theta + M_PI / 4;
+    return lround((motor.field - rotor) / (2 * M_PI)) * 4 * STEP_DIVISION;
+  }
+
+  private:
+  std::mt19937 rng;
+  std::normal_distribution<float> noise;
+
+  static ArmSim* active;
+
+  static void Interrupt() {
+    active->Tick();
+  }
+
+  static int AnalogSource(uint8_t channel) {
+    for (int m = 0; m < 2; m++) {
+      if (active->motors[m].pot - A0 == channel) {
+        return active->ReadPot(m);
+      }
+    }
+    return HalAnalog[channel];
+  }
+
+  static int DigitalSource(uint8_t pin) {
+    for (int m = 0; m < 2; m++) {
+      if (active->motors[m].hes != 0 && active->motors[m].hes == pin) {
+        return active->motors[m].hes_on ? HES_ACTIVE : !HES_ACTIVE;
+      }
+    }
+    return HalInput[pin];
+  }
+
+  int ReadPot(int m) {
+    float reading = POT_CENTER + (printAngle(m) - 1.5707963) * POT_COUNTS_PER_RADIAN + this->pot_noise * noise(rng);
+    return (int)constrain(lroundf(reading), 0L, (long)POT_MAX);
+  }
+
+  // Current through one coil from its two pins, -1 to 1
+  static float Coil(uint8_t plus, uint8_t minus) {
+#if defined(COIL_PWM)
+    return (max(HalAnalogOut[plus], 0) - max(HalAnalogOut[minus], 0)) / 255.0f;  // -1 is never written
+#else
+    return (digitalRead(plus) == HIGH) - (digitalRead(minus) == HIGH);
+#endif
+  }
+
+  void UpdateHes(Motor& motor) {
+    if (motor.hes == 0) {
+      return;
+    }
+    double d = remainder(motor.start - motor.theta - this->hes_angle, 2 * M_PI);
+    double b = exp(-(d * d) / (this->hes_width * this->hes_width));
+    motor.hes_on = motor.hes_on ? b > this->hes_off : b > this->hes_on;
+  }
+
+  void Step(Motor& motor, double dt) {
+    const MotorModel& model = motor.model;
+    float a = Coil(motor.coil[0], motor.coil[1]);
+    float c = Coil(motor.coil[2], motor.coil[3]);
+    float strength = sqrt(a * a + c * c) / 1.4142136f;  // both coils full on is the holding torque
+    if (strength > 0) {
+      double turn = remainder(atan2(c, a) - motor.field, 2 * M_PI);
+      motor.field += turn;
+      motor.field_speed += (turn / dt - motor.field_speed) * dt / 0.005;  // 5 ms time constant
+    }
+    else {
+      motor.field_speed = 0;
+    }
+
+    double rotor = SIM_POLE_PAIRS * motor.theta + M_PI / 4;
+    double speed = motor.omega;
+    double k = model.hold / sqrt(1 + (speed / model.corner) * (speed / model.corner));
+    double torque = k * strength * sin(motor.field - rotor)
+                  - model.detent * sin(4 * SIM_POLE_PAIRS * motor.theta)
+                  - model.viscous * speed
+                  - (strength > 0 ? model.damping * (speed - motor.field_speed / SIM_POLE_PAIRS) : 0);
+
+    // Coulomb friction holds it still until the rest of the torque gets past it
+    if (speed == 0 && fabs(torque) <= model.friction) {
+      return;
+    }
+    torque -= model.friction * (speed != 0 ? (speed > 0 ? 1 : -1) : (torque > 0 ? 1 : -1));
+    double next = speed + torque / model.inertia * dt;
+    if ((speed > 0 && next < 0) || (speed < 0 && next > 0)) {
+      next = 0;  // friction stops it, it doesn't turn it round
+    }
+    motor.omega = next;
+    motor.theta += next * dt;
+
+    double angle = motor.start - motor.theta;
+    if (angle < motor.low || angle > motor.high) {
+      motor.theta = motor.start - (angle < motor.low ? motor.low : motor.high);
+      motor.omega = 0;
+      this->blocked++;
+    }
+  }
+
+  void Tick() {
+    const double dt = SIM_DT_US / 1e6;
+    double before[2] = {this->motors[0].theta, this->motors[1].theta};
+    Step(this->motors[0], dt);
+    Step(this->motors[1], dt);
+    float x, y;
+    if (this->linkage && !ForwardTransfer((float)printAngle(0), (float)printAngle(1), x, y)) {
+      for (int m = 0; m < 2; m++) {
+        this->motors[m].theta = before[m];
+        this->motors[m].omega = 0;
+      }
+      this->blocked++;
+    }
+    UpdateHes(this->motors[0]);
+    UpdateHes(this->motors[1]);
+  }
+};
+
+ArmSim* ArmSim::active = 0;
@@ -0,0 +1,74 @@
+// Host benchmark for CartesianTransferBatch against the old one-point-at-a-time loop
+// Also checks that both give the same answer for every point
+//
+// Build: g++ -O2 -march=native -o BenchBatchIK tools/BenchBatchIK.cpp
+// Run:   ./BenchBatchIK [points]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../CoordinateBatch.h"
+
+int main(int argc, char** argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+  const int rounds = 10;
+
+  // Random points over a box a bit bigger than the reachable area so both branches get used
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> rx(-150, 200), ry(0, 200);
+  std::vector<float> x(count), y(count);
+  for (int i = 0; i < count; i++) {
+    x[i] = rx(rng);
+    y[i] = ry(rng);
+  }
+
+  std::vector<float> theta(count), phi(count), batchTheta(count), batchPhi(count);
+  std::vector<char> valid(count);
+  bool* batchValid = new bool[count];
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < count; i++) {
+      valid[i] = CartesianTransfer(x[i], y[i], theta[i], phi[i]);
+    }
+  }
+  double scalarTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int reachable = 0;
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    reachable = CartesianTransferBatch(x.data(), y.data(), batchTheta.data(), batchPhi.data(), batchValid, count);
+  }
+  double batchTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int mismatched = 0;
+  float worst = 0;
+  for (int i = 0; i < count; i++) {
+    if (bool(valid[i]) != batchValid[i]) {
+      mismatched++;
+      continue;
+    }
+    if (valid[i]) {
+      worst = fmaxf(worst, fabsf(theta[i] - batchTheta[i]));
+      worst = fmaxf(worst, fabsf(phi[i] - batchPhi[i]));
+    }
+  }
+
+#if defined(__AVX__)
+  const char* path = "AVX";
+#elif defined(__SSE2__)
+  const char* path = "SSE2";
+#else
+  const char* path = "scalar";
+#endif
+
+  printf("points: %d (%d reachable), batch path: %s\n", count, reachable, path);
+  printf("per-point loop: %.1f Mpoints/s\n", count * rounds / scalarTime / 1e6);
+  printf("batch:          %.1f Mpoints/s (%.1fx)\n", count * rounds / batchTime / 1e6, scalarTime / batchTime);
+  printf("valid flag mismatches: %d, worst angle difference: %.3g rad\n", mismatched, worst);
+
+  delete[] batchValid;
+  return mismatched == 0 && worst < 1e-5f ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// Steps per second of each ScaraStepper coil path (CoilPins.h) on the simulated Uno (HalLinux.h)
+// Each motor is driven round and round with Advance, then the port bytes are checked so the faster paths are
+// known to leave the pins exactly where the digitalWrite one does. The pins are the FiveBarLinkage ones: the left
+// motor is all on PORTD, the right one is split over PORTD and PORTB.
+// The absolute numbers are host numbers, what carries over to the board is the work per step: four table lookups
+// and read-modify-writes for digitalWrite, one read-modify-write per port for the other two.
+//
+// Build: g++ -O2 -o BenchCoilWrites tools/BenchCoilWrites.cpp
+// Run:   ./BenchCoilWrites [steps]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../ScaraStepper.h"
+
+template <class Left, class Right>
+double Run(Left& left, Right& right, long steps, uint8_t ports[4]) {
+  HalPorts[1] = HalPorts[2] = HalPorts[3] = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < steps; i++) {
+    left.Advance(1);
+    right.Advance(-1);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (int i = 0; i < 4; i++) {
+    ports[i] = HalPorts[i];
+  }
+  return 2 * steps / seconds;
+}
+
+int main(int argc, char** argv) {
+  long steps = argc > 1 ? atol(argv[1]) : 20000000;
+
+  BasicScaraStepper<DigitalCoils> digitalLeft(3,5,4,6,A0), digitalRight(7,9,8,10,A1);
+  BasicScaraStepper<PortCoils> portLeft(3,5,4,6,A0), portRight(7,9,8,10,A1);
+  FixedScaraStepper<3,5,4,6> fixedLeft(3,5,4,6,A0);
+  FixedScaraStepper<7,9,8,10> fixedRight(7,9,8,10,A1);
+
+  uint8_t digitalPorts[4], portPorts[4], fixedPorts[4];
+  double digital = Run(digitalLeft, digitalRight, steps, digitalPorts);
+  double port = Run(portLeft, portRight, steps, portPorts);
+  double fixed = Run(fixedLeft, fixedRight, steps, fixedPorts);
+
+  bool same = true;
+  for (int i = 1; i < 4; i++) {
+    same = same && digitalPorts[i] == portPorts[i] && digitalPorts[i] == fixedPorts[i];
+  }
+
+  printf("%ld steps per motor\n", steps);
+  printf("digitalWrite: %6.1f M steps/s\n", digital / 1e6);
+  printf("PortCoils:    %6.1f M steps/s (%.1fx)\n", port / 1e6, port / digital);
+  printf("FixedCoils:   %6.1f M steps/s (%.1fx)\n", fixed / 1e6, fixed / digital);
+  printf("pins after the run %s (PORTB %02x PORTD %02x)\n", same ? "match" : "DIFFER", digitalPorts[1],
+         digitalPorts[3]);
+  return same ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// Accuracy and speed of each FastMath.h tier, on its own and inside CartesianTransfer
+// The IK error is against tier 0 (libm) and is turned into a tool error with the Jacobian at the libm angles.
+// These are the numbers quoted at the top of FastMath.h.
+//
+// Build: g++ -O2 -o BenchFastMath tools/BenchFastMath.cpp
+// Run:   ./BenchFastMath [grid step in mm]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../CoordinateTransfer.h"
+
+struct TierResult {
+  double atan2Error, rsqrtError;
+  float angleError, toolError, usableError;
+  int mismatched;
+  double seconds;
+};
+
+template <int Tier>
+TierResult Measure(const std::vector<float>& xs, const std::vector<float>& ys,
+                   const std::vector<float>& theta, const std::vector<float>& phi, const std::vector<char>& valid) {
+  TierResult result = {0, 0, 0, 0, 0, 0, 0};
+
+  for (int i = 0; i < 100000; i++) {
+    // The references are worked out from the same float inputs
+    double a = -3.14159 + 6.28318 * i / 100000;
+    float sy = (float)sin(a), sx = (float)cos(a);
+    result.atan2Error = fmax(result.atan2Error, fabs(FastAtan2<Tier>(sy, sx) - atan2((double)sy, (double)sx)));
+    float v = (float)pow(10, -3 + 8.0 * i / 100000);
+    result.rsqrtError = fmax(result.rsqrtError, fabs(FastRsqrt<Tier>(v) * sqrt((double)v) - 1));
+  }
+
+  int count = (int)xs.size();
+  std::vector<float> t(count), p(count);
+  std::vector<char> ok(count);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    ok[i] = CartesianTransfer<KindLadyArm, Tier>(xs[i], ys[i], t[i], p[i]);
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / count;
+
+  for (int i = 0; i < count; i++) {
+    if (ok[i] != valid[i]) {
+      result.mismatched++;
+      continue;
+    }
+    if (!valid[i]) {
+      continue;
+    }
+    float dt = t[i] - theta[i];
+    float dp = p[i] - phi[i];
+    result.angleError = fmaxf(result.angleError, fmaxf(fabsf(dt), fabsf(dp)));
+    float J[2][2], condition;
+    if (Jacobian(theta[i], phi[i], J, condition)) {
+      float error = hypotf(J[0][0]*dt + J[0][1]*dp, J[1][0]*dt + J[1][1]*dp);
+      result.toolError = fmaxf(result.toolError, error);
+      if (condition < 10) {
+        result.usableError = fmaxf(result.usableError, error);
+      }
+    }
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  float step = argc > 1 ? atof(argv[1]) : 0.25f;
+
+  std::vector<float> xs, ys;
+  for (float y = KindLadyArm::MinY; y < KindLadyArm::LeftReach; y += step) {
+    for (float x = KindLadyArm::Base - KindLadyArm::RightReach; x < KindLadyArm::LeftReach; x += step) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+  int count = (int)xs.size();
+  std::vector<float> theta(count), phi(count);
+  std::vector<char> valid(count);
+  for (int i = 0; i < count; i++) {
+    valid[i] = CartesianTransfer<KindLadyArm, 0>(xs[i], ys[i], theta[i], phi[i]);
+  }
+
+  TierResult results[4] = {
+    Measure<0>(xs, ys, theta, phi, valid),
+    Measure<1>(xs, ys, theta, phi, valid),
+    Measure<2>(xs, ys, theta, phi, valid),
+    Measure<3>(xs, ys, theta, phi, valid),
+  };
+
+  printf("%d points at %.2f mm\n", count, step);
+  // Next to the singular edges any angle error is blown up at the tool, so the tool error is also given for
+  // the part of the area where the Jacobian condition number is under 10
+  printf("tier  atan2     1/sqrt    | IK angle  tool um   (cond<10) reach mismatches  ns/point\n");
+  for (int tier = 0; tier < 4; tier++) {
+    const TierResult& r = results[tier];
+    printf("%d     %-9.2g %-9.2g | %-9.2g %-9.3g %-9.3g %-17d %.0f\n", tier, r.atan2Error, r.rsqrtError,
+           r.angleError, r.toolError * 1000, r.usableError * 1000, r.mismatched, r.seconds * 1e9);
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+// Host benchmark for StreamingTransfer against calling CartesianTransfer for every segment
+// The path is a set of loops over the area cut into short segments, like a sliced toolpath.
+//
+// Build: g++ -O2 -o BenchStreamingIK tools/BenchStreamingIK.cpp
+// Run:   ./BenchStreamingIK [segment length in mm]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../StreamingTransfer.h"
+
+int main(int argc, char** argv) {
+  float segment = argc > 1 ? atof(argv[1]) : 0.05f;
+
+  // Rose curve around the middle of the area, walked at roughly constant speed
+  std::vector<float> xs, ys;
+  float a = 0;
+  while (a < 40 * 3.14159f) {
+    float r = 40 + 20 * sinf(3 * a);
+    xs.push_back(25 + r * cosf(a) * 1.5f);
+    ys.push_back(100 + r * sinf(a));
+    a += segment / r;
+  }
+  int count = (int)xs.size();
+  std::vector<float> theta(count), phi(count), streamTheta(count), streamPhi(count);
+  std::vector<char> valid(count), streamValid(count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    valid[i] = CartesianTransfer(xs[i], ys[i], theta[i], phi[i]);
+  }
+  double closedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  StreamingTransfer<> solver;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    streamValid[i] = solver.Next(xs[i], ys[i], streamTheta[i], streamPhi[i]);
+  }
+  double streamTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  int mismatched = 0, reachable = 0;
+  float worst = 0;
+  for (int i = 0; i < count; i++) {
+    reachable += valid[i];
+    if (valid[i] != streamValid[i]) {
+      mismatched++;
+    }
+    else if (valid[i]) {
+      worst = fmaxf(worst, fmaxf(fabsf(theta[i] - streamTheta[i]), fabsf(phi[i] - streamPhi[i])));
+    }
+  }
+
+  printf("%d segments of %.3f mm (%d reachable), %lu went through the closed form\n",
+         count, segment, reachable, solver.printFallbacks());
+  printf("closed form: %.0f ns/segment\n", closedTime / count * 1e9);
+  printf("streaming:   %.0f ns/segment (%.1fx)\n", streamTime / count * 1e9, closedTime / streamTime);
+  printf("reachability mismatches: %d, worst angle difference %.3g rad\n", mismatched, worst);
+  return mismatched == 0 && worst < 1e-4f ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// Error report for FixedTransfer against the float CartesianTransfer over the whole area
+// Prints the worst and mean angle error, what that means at the tool, and how many step counts disagree.
+//
+// Build: g++ -O2 -o FixedTransferReport tools/FixedTransferReport.cpp
+//        (add -DFIXED_FRACTION_BITS=n to try another Q format)
+// Run:   ./FixedTransferReport [grid step in mm]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../FixedTransfer.h"
+
+int main(int argc, char** argv) {
+  float step = argc > 1 ? atof(argv[1]) : 0.25f;
+
+  std::vector<float> xs, ys;
+  for (float y = KindLadyArm::MinY; y < KindLadyArm::LeftReach; y += step) {
+    for (float x = KindLadyArm::Base - KindLadyArm::RightReach; x < KindLadyArm::LeftReach; x += step) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+  int count = (int)xs.size();
+
+  int reachable = 0, mismatched = 0, stepsOff = 0;
+  double total = 0;
+  float worst = 0, worstX = 0, worstY = 0, worstTool = 0, worstFloatTool = 0;
+  for (int i = 0; i < count; i++) {
+    float theta, phi;
+    fixed fixedTheta, fixedPhi;
+    bool valid = CartesianTransfer(xs[i], ys[i], theta, phi);
+    bool fixedValid = FixedTransferAngles<KindLadyArm>(ToFixed(xs[i]), ToFixed(ys[i]), fixedTheta, fixedPhi);
+    if (valid != fixedValid) {
+      mismatched++;
+      continue;
+    }
+    if (!valid) {
+      continue;
+    }
+    reachable++;
+
+    float error = fmaxf(fabsf(FromFixed(fixedTheta) - theta), fabsf(FromFixed(fixedPhi) - phi));
+    total += error;
+    if (error > worst) {
+      worst = error;
+      worstX = xs[i];
+      worstY = ys[i];
+    }
+
+    // Where the tool ends up with the fixed point angles
+    float x, y;
+    if (ForwardTransfer(FromFixed(fixedTheta), FromFixed(fixedPhi), x, y)) {
+      worstTool = fmaxf(worstTool, hypotf(x - xs[i], y - ys[i]));
+    }
+    // and with the float ones, what the round trip itself loses near full reach
+    if (ForwardTransfer(theta, phi, x, y)) {
+      worstFloatTool = fmaxf(worstFloatTool, hypotf(x - xs[i], y - ys[i]));
+    }
+
+    int32_t thetaSteps = 0, phiSteps = 0;
+    FixedTransfer(ToFixed(xs[i]), ToFixed(ys[i]), thetaSteps, phiSteps);
+    if (thetaSteps != lroundf(theta * STEPS_PER_RADIAN) || phiSteps != lroundf(phi * STEPS_PER_RADIAN)) {
+      stepsOff++;
+    }
+  }
+
+  // Rough host timing, only useful to compare the two on the same machine. The results go to a volatile so the
+  // loops can't be optimised away. On an FPU the float version wins, see FixedTransfer.h.
+  volatile int32_t stepsSink;
+  volatile float angleSink;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    int32_t thetaSteps = 0, phiSteps = 0;
+    FixedTransfer(ToFixed(xs[i]), ToFixed(ys[i]), thetaSteps, phiSteps);
+    stepsSink = thetaSteps + phiSteps;
+  }
+  double fixedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++) {
+    float theta = 0, phi = 0;
+    CartesianTransfer(xs[i], ys[i], theta, phi);
+    angleSink = theta + phi;
+  }
+  double floatTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  (void)stepsSink;
+  (void)angleSink;
+
+  printf("Q%d.%d, %d points, %d reachable, %d disagree on reachability\n",
+         32 - FIXED_FRACTION_BITS, FIXED_FRACTION_BITS, count, reachable, mismatched);
+  printf("angle error: worst %.3g rad at (%.2f, %.2f), mean %.3g rad\n", worst, worstX, worstY, total / reachable);
+  printf("tool error:  worst %.3g mm (%.3g mm with the float angles)\n", worstTool, worstFloatTool);
+  printf("step counts different from rounding the float angles: %d (%.3f%%)\n", stepsOff, 100.0 * stepsOff / reachable);
+  printf("host time per point: fixed %.0f ns, float %.0f ns\n", fixedTime / count * 1e9, floatTime / count * 1e9);
+  return 0;
+}
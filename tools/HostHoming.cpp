@@ -0,0 +1,83 @@
+// Runs Homing.h against a simulated HES on the host (Hal.h's Linux backend)
+// The motor is a ScaraStepper that also counts its steps, and the HES reads active within on_width steps of the
+// magnet and stays on until it is off_width away, like a comparator with hysteresis. Homing should leave the motor
+// on a full step less than one full step from the magnet (the edges are only seen to the nearest step) from
+// wherever it starts: ahead of the HES, behind it within the blind sweep, or already over it. Starting too far
+// behind it has to fail instead, with the coils off.
+//
+// Build: g++ -O2 -o HostHoming tools/HostHoming.cpp
+// Run:   ./HostHoming [magnet position in steps] [on_width] [off_width]
+#include <cstdio>
+#include <cstdlib>
+
+#include "../ScaraStepper.h"
+#include "../Homing.h"
+
+#define HES_PIN 2
+
+class CountingStepper : public ScaraStepper {
+  public:
+  long position;
+
+  CountingStepper(int a, int b, int c, int d, int pot) : ScaraStepper(a, b, c, d, pot) {
+    this->position = 0;
+  }
+
+  void Advance(int direction) {
+    this->position += direction > 0 ? 1 : direction < 0 ? -1 : 0;
+    ScaraStepper::Advance(direction);
+  }
+};
+
+CountingStepper* Motor;
+double Magnet, OnWidth, OffWidth;
+bool Active;
+
+int ReadHes(uint8_t pin) {
+  if (pin != HES_PIN) {
+    return LOW;
+  }
+  double distance = Motor->position - Magnet;
+  distance = distance < 0 ? -distance : distance;
+  Active = Active ? distance <= OffWidth : distance <= OnWidth;
+  return Active ? HES_ACTIVE : !HES_ACTIVE;
+}
+
+int main(int argc, char** argv) {
+  double magnet = argc > 1 ? atof(argv[1]) : 0.4 * STEP_DIVISION;
+  OnWidth = argc > 2 ? atof(argv[2]) : 3.2 * STEP_DIVISION;
+  OffWidth = argc > 3 ? atof(argv[3]) : 4.1 * STEP_DIVISION;
+
+  // Start positions relative to the magnet, direction +1 heads towards it from the working area
+  const long starts[] = {-150, -40, -3, 0, 2, 10, 45, 120};
+  int failures = 0;
+  printf("%8s %8s %6s %21s %21s %6s %8s\n", "start", "steps", "found", "tracking on..off", "aiming on..off",
+         "home", "error");
+  for (long start : starts) {
+    start *= STEP_DIVISION;
+    HalReset();
+    HalDigitalSource = ReadHes;
+    CountingStepper motor(3,5,4,6,A0);
+    Motor = &motor;
+    Magnet = magnet - start;
+    Active = false;
+
+    HomingReport report;
+    bool found = Homing(motor, HES_PIN, 1, &report);
+    // Should find it unless it starts behind the HES further than the blind sweep reaches
+    bool expected = start < 0 || start <= HOMING_BLIND_STEPS - OnWidth;
+    double error = motor.position - Magnet;
+    bool good = found == expected &&
+                (!found || (fabs(error) < STEP_DIVISION && motor.printStep() % STEP_DIVISION == 0));
+    failures += !good;
+    if (found) {
+      printf("%8ld %8ld %6s %10ld..%-10ld %10ld..%-10ld %6ld %8.2f%s\n", start, motor.position, "yes",
+             report.on[0], report.off[0], report.on[1], report.off[1], report.home, error, good ? "" : "  WRONG");
+    }
+    else {
+      printf("%8ld %8ld %6s %45s%s\n", start, motor.position, "no", "", good ? "" : "  WRONG");
+    }
+  }
+  printf("%s, %.1f ms of virtual time in the last run\n", failures ? "FAILED" : "all as expected", HalNow / 1000.0);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+// Runs the FiveBarLinkage sketch as an ordinary program on the host (Hal.h's Linux backend)
+// setup() once, then loop() over and over with loop_us of virtual time after each pass (about what its arithmetic
+// takes on an Uno, Serial adds its own waits), while the step and pot sampling timers tick in between. The goal
+// pots are scripted to jump to the given readings after 100 ms and the motor pots are held where they are, so the
+// motors keep working towards goals they never reach, which is what to profile. Every pin change can be written
+// out to a CSV.
+// The step counts at the end come from the recorded coil transitions, one step being one change of coil state.
+//
+// Build: g++ -O2 -o HostSketch tools/HostSketch.cpp            (add -DPOT_FOLLOW for the closed loop version,
+//        -DINSTRUMENT to print Instrument.h's scopes at the end, timed with the host's clock, -DTRACE to end
+//        the --serial capture with Trace.h's ring for tools/TraceChrome.cpp)
+// Run:   ./HostSketch [seconds] [left goal] [right goal] [--loop us] [--log transitions.csv] [--serial capture.bin]
+//                     [--stream circle|path.txt]
+//        (the capture is what went out of the serial port, tools/TelemetryDecode.cpp reads it)
+// --stream plays XYSend.cpp's part over the serial port in virtual time: it streams the waypoints (laps of a circle
+// with 1 mm between points, or a file like XYSend takes) and says what segments/s the sketch kept up.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../Hal.h"
+#include "../FiveBarLinkage"
+#include "XYSender.h"
+
+XYSender Sender;
+
+void SenderTap(uint8_t c) {
+  Sender.Receive(c, HalNow);
+}
+
+int main(int argc, char** argv) {
+  double seconds = 2;
+  int goals[2] = {300, 700};
+  uint32_t loopUs = 1000;
+  const char* logPath = 0;
+  const char* serialPath = 0;
+  const char* streamPath = 0;
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--loop") && i + 1 < argc) {
+      loopUs = atol(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--log") && i + 1 < argc) {
+      logPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--stream") && i + 1 < argc) {
+      streamPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--serial") && i + 1 < argc) {
+      serialPath = argv[++i];
+    }
+    else if (positional == 0) {
+      seconds = atof(argv[i]);
+      positional++;
+    }
+    else if (positional < 3) {
+      goals[positional - 1] = atoi(argv[i]);
+      positional++;
+    }
+  }
+
+  HalSerialOut = 0;
+  if (serialPath) {
+    HalSerialOut = fopen(serialPath, "wb");
+    if (!HalSerialOut) {
+      fprintf(stderr, "can't write %s\n", serialPath);
+      return 1;
+    }
+  }
+  HalRecording = true;
+  HalScriptAnalog(A4, 100000, goals[0]);  // left goal
+  HalScriptAnalog(A3, 100000, goals[1]);  // right goal
+
+  if (streamPath) {
+#if defined(POT_FOLLOW)
+    fprintf(stderr, "the sketch only streams without POT_FOLLOW\n");
+    return 1;
+#endif
+    if (!strcmp(streamPath, "circle")) {
+      Sender.path = CirclePath(3, 1, 200);
+    }
+    else if (!LoadPath(streamPath, Sender.path)) {
+      fprintf(stderr, "can't read %s\n", streamPath);
+      return 1;
+    }
+    HalSerialTap = SenderTap;
+  }
+
+  setup();
+  long passes = 0;
+  uint8_t frame[XY_FRAME_MAX];
+  while (HalNow < seconds * 1e6) {
+    size_t length;
+    while (streamPath && Serial.Pending() == 0 && (length = Sender.Next(HalNow, frame)) > 0) {
+      Serial.Receive(frame, length);
+    }
+    loop();
+    HalAdvance(loopUs);
+    passes++;
+  }
+
+  // Coil states per motor from the log, a step is every instant one of its pins changed
+  const uint8_t coils[2][4] = {{3, 5, 4, 6}, {7, 9, 8, 10}};
+  long steps[2] = {0, 0};
+  uint64_t last[2] = {~0ULL, ~0ULL};
+  for (size_t i = 0; i < HalLog.size(); i++) {
+    for (int m = 0; m < 2; m++) {
+      for (int c = 0; c < 4; c++) {
+        if (HalLog[i].pin == coils[m][c] && HalLog[i].time != last[m]) {
+          steps[m]++;
+          last[m] = HalLog[i].time;
+        }
+      }
+    }
+  }
+
+  printf("%.2f s virtual, %ld passes of loop(), %zu pin transitions\n", HalNow / 1e6, passes, HalLog.size());
+  printf("coil state changes: left %ld, right %ld\n", steps[0], steps[1]);
+  printf("%-10s %8s %9s %9s %9s %9s\n", "task", "runs", "overruns", "late max", "late mean", "time max");
+  for (uint8_t i = 0; i < Tasks.Count(); i++) {
+    printf("%-10s %8lu %9u %9lu %9lu %9lu\n", Tasks.printName(i), (unsigned long)Tasks.printRuns(i),
+           Tasks.printOverruns(i), (unsigned long)Tasks.printLateMax(i), (unsigned long)Tasks.printLateMean(i),
+           (unsigned long)Tasks.printTimeMax(i));
+  }
+  if (streamPath) {
+    printf("stream: %zu of %zu waypoints consumed, %.1f segments/s, %u rejected, %ld resends, %ld acks, "
+           "%ld bytes lost to RX overruns\n", Sender.Consumed(), Sender.path.size(), Sender.printRate(),
+           Sender.rejected, Sender.resends, Sender.acks, Serial.printOverruns());
+#if !defined(POT_FOLLOW)
+    printf("stream IK: %lu of %zu waypoints went through the closed form\n", StreamSolver.printFallbacks(),
+           Sender.Consumed());
+#endif
+  }
+  printf("telemetry: %u frames, %u dropped\n", Telemetry.printSequence(), Telemetry.printDropped());
+#if !defined(POT_FOLLOW)
+  printf("motion queue: high watermark %u, underruns %u\n", Motion.printHighWatermark(), Motion.printUnderruns());
+#endif
+
+  if (HalSerialOut) {
+#if defined(TRACE)
+    HalSerialTap = 0;
+    Telemetry.Flush();
+    TraceDump(Serial);
+#endif
+    fclose(HalSerialOut);
+  }
+#if defined(INSTRUMENT)
+  HalSerialOut = stdout;
+  HalSerialTap = 0;
+  InstrumentDump(Serial);
+#endif
+  if (logPath) {
+    FILE* out = fopen(logPath, "w");
+    if (!out) {
+      fprintf(stderr, "can't write %s\n", logPath);
+      return 1;
+    }
+    fprintf(out, "time_us,pin,value,pwm\n");
+    for (size_t i = 0; i < HalLog.size(); i++) {
+      fprintf(out, "%llu,%u,%u,%d\n", (unsigned long long)HalLog[i].time, HalLog[i].pin, HalLog[i].value,
+              HalLog[i].pwm ? 1 : 0);
+    }
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+// Generates the joint angle lookup table used by JointTableTransfer (see JointTable.h)
+//
+// Build: g++ -O2 -o JointTableGen tools/JointTableGen.cpp
+// Run:   ./JointTableGen [--step mm] [--tolerance rad] [--header file.h | --binary file.bin]
+//
+// The header holds PROGMEM arrays plus a ready to use "const JointTable KindLadyJointTable".
+// The binary blob is for loading from SD or a host: "KLJT", uint16 version, uint16 cols, uint16 rows,
+// float x0, y0, step, max_error, then theta[], phi[] (int16) and the fallback bits, all little endian.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../JointTable.h"
+
+static void writeArray(FILE* out, const char* type, const char* name, const void* data, int count, bool bytes) {
+  fprintf(out, "static const %s %s[] PROGMEM = {", type, name);
+  for (int i = 0; i < count; i++) {
+    if (i % 16 == 0) {
+      fprintf(out, "\n  ");
+    }
+    if (bytes) {
+      fprintf(out, "%u,", ((const uint8_t*)data)[i]);
+    }
+    else {
+      fprintf(out, "%d,", ((const int16_t*)data)[i]);
+    }
+  }
+  fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char** argv) {
+  float step = 2;
+  float tolerance = 0.0005f;
+  const char* header = NULL;
+  const char* binary = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--step")) step = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--tolerance")) tolerance = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--header")) header = argv[i+1];
+    else if (!strcmp(argv[i], "--binary")) binary = argv[i+1];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  // Bounding box of the reachable area: left of the base it is limited by the right arm, right of it by the left arm
+  JointTable table;
+  table.x0 = KindLadyArm::Base - KindLadyArm::RightReach;
+  table.y0 = KindLadyArm::MinY;
+  table.step = step;
+  table.cols = (uint16_t)((KindLadyArm::LeftReach - table.x0) / step) + 2;
+  table.rows = (uint16_t)((KindLadyArm::LeftReach - table.y0) / step) + 2;
+
+  std::vector<int16_t> theta(table.cols * table.rows), phi(table.cols * table.rows);
+  std::vector<uint8_t> fallback(JointTableFallbackBytes(table.cols, table.rows));
+  float worst = BuildJointTable(table, theta.data(), phi.data(), fallback.data(), tolerance);
+
+  // Only count cells that are completely inside the area, the rest fall back no matter what
+  int cells = 0, flagged = 0, reachable = 0, outside = 0;
+  for (int row = 0; row < table.rows - 1; row++) {
+    for (int col = 0; col < table.cols - 1; col++) {
+      int cell = row * (table.cols - 1) + col;
+      int i = row * table.cols + col;
+      if (theta[i] == JOINT_TABLE_EMPTY || theta[i + 1] == JOINT_TABLE_EMPTY
+          || theta[i + table.cols] == JOINT_TABLE_EMPTY || theta[i + table.cols + 1] == JOINT_TABLE_EMPTY) {
+        continue;
+      }
+      cells++;
+      flagged += (fallback[cell / 8] >> (cell % 8)) & 1;
+    }
+  }
+  for (int i = 0; i < table.cols * table.rows; i++) {
+    float t, p;
+    reachable += theta[i] != JOINT_TABLE_EMPTY;
+    outside += theta[i] == JOINT_TABLE_EMPTY &&
+               CartesianTransfer(table.x0 + (i % table.cols) * step, table.y0 + (i / table.cols) * step, t, p);
+  }
+  int bytes = (int)(theta.size() * 4 + fallback.size());
+
+  fprintf(stderr, "grid %dx%d at %.2f mm, %d reachable points, %d bytes\n", table.cols, table.rows, step, reachable,
+          bytes);
+  fprintf(stderr, "%d of %d cells inside the area fall back to CartesianTransfer, worst interpolated error %.3g rad\n",
+          flagged, cells, worst);
+  if (outside > 0) {
+    fprintf(stderr, "%d reachable points have angles past what JOINT_TABLE_SCALE fits in an int16, they fall back\n",
+            outside);
+  }
+
+  if (header) {
+    FILE* out = fopen(header, "w");
+    if (!out) {
+      perror(header);
+      return 1;
+    }
+    fprintf(out, "// Generated by tools/JointTableGen.cpp, do not edit\n");
+    fprintf(out, "// step %.3f mm, tolerance %.3g rad, worst interpolated error %.3g rad, %d bytes\n", step, tolerance,
+            worst, bytes);
+    fprintf(out, "#pragma once\n#include \"JointTable.h\"\n\n");
+    writeArray(out, "int16_t", "KindLadyTheta", theta.data(), (int)theta.size(), false);
+    writeArray(out, "int16_t", "KindLadyPhi", phi.data(), (int)phi.size(), false);
+    writeArray(out, "uint8_t", "KindLadyFallback", fallback.data(), (int)fallback.size(), true);
+    fprintf(out, "const JointTable KindLadyJointTable = {%.6ff, %.6ff, %.6ff, %u, %u, %.6ef, "
+            "KindLadyTheta, KindLadyPhi, KindLadyFallback, true};\n",
+            table.x0, table.y0, table.step, table.cols, table.rows, worst);
+    fclose(out);
+  }
+
+  if (binary) {
+    FILE* out = fopen(binary, "wb");
+    if (!out) {
+      perror(binary);
+      return 1;
+    }
+    uint16_t version = JOINT_TABLE_VERSION;
+    float floats[4] = {table.x0, table.y0, table.step, worst};
+    fwrite("KLJT", 1, 4, out);
+    fwrite(&version, 2, 1, out);
+    fwrite(&table.cols, 2, 1, out);
+    fwrite(&table.rows, 2, 1, out);
+    fwrite(floats, 4, 4, out);
+    fwrite(theta.data(), 2, theta.size(), out);
+    fwrite(phi.data(), 2, phi.size(), out);
+    fwrite(fallback.data(), 1, fallback.size(), out);
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+// Round trip check of the kinematics: XY -> CartesianTransfer -> ForwardTransfer -> XY over the whole area
+// Prints the worst and average position error and where the worst one is, then does the same with the batch versions.
+// Expect the worst case (a few microns) along y = 28, where the distal links get close to the inner singularity
+// and float rounding in the angles is magnified the most.
+//
+// Build: g++ -O2 -march=native -o KinematicsRoundTrip tools/KinematicsRoundTrip.cpp
+// Run:   ./KinematicsRoundTrip [grid step in mm] [allowed error in mm]
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../CoordinateBatch.h"
+
+int main(int argc, char** argv) {
+  float step = argc > 1 ? atof(argv[1]) : 0.25f;
+  float allowed = argc > 2 ? atof(argv[2]) : 0.01f;
+
+  std::vector<float> xs, ys;
+  for (float y = KindLadyArm::MinY; y < KindLadyArm::LeftReach; y += step) {
+    for (float x = KindLadyArm::Base - KindLadyArm::RightReach; x < KindLadyArm::LeftReach; x += step) {
+      xs.push_back(x);
+      ys.push_back(y);
+    }
+  }
+  int count = (int)xs.size();
+
+  // One point at a time
+  int reachable = 0, lost = 0;
+  double total = 0;
+  float worst = 0, worstX = 0, worstY = 0;
+  for (int i = 0; i < count; i++) {
+    float theta, phi, x, y;
+    if (!CartesianTransfer(xs[i], ys[i], theta, phi)) {
+      continue;
+    }
+    reachable++;
+    if (!ForwardTransfer(theta, phi, x, y)) {
+      lost++;
+      continue;
+    }
+    float error = hypotf(x - xs[i], y - ys[i]);
+    total += error;
+    if (error > worst) {
+      worst = error;
+      worstX = xs[i];
+      worstY = ys[i];
+    }
+  }
+  printf("%d points, %d reachable, %d with no forward solution\n", count, reachable, lost);
+  printf("scalar: worst %.3g mm at (%.2f, %.2f), mean %.3g mm\n", worst, worstX, worstY, total / reachable);
+
+  // Whole arrays at once
+  std::vector<float> theta(count), phi(count), x(count), y(count);
+  bool* valid = new bool[count];
+  bool* solved = new bool[count];
+  CartesianTransferBatch(xs.data(), ys.data(), theta.data(), phi.data(), valid, count);
+  ForwardTransferBatch(theta.data(), phi.data(), x.data(), y.data(), solved, count);
+
+  float batchWorst = 0;
+  int batchLost = 0;
+  for (int i = 0; i < count; i++) {
+    if (!valid[i]) {
+      continue;
+    }
+    if (!solved[i]) {
+      batchLost++;
+      continue;
+    }
+    batchWorst = fmaxf(batchWorst, hypotf(x[i] - xs[i], y[i] - ys[i]));
+  }
+  printf("batch:  worst %.3g mm, %d with no forward solution\n", batchWorst, batchLost);
+
+  delete[] valid;
+  delete[] solved;
+  return (lost || batchLost || worst > allowed || batchWorst > allowed) ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+// Pre-flight check of a whole XY path file before any of it is sent to the arm
+// Every point goes through the same CartesianTransfer the controller uses and is flagged when it is
+//   - out of reach (CartesianTransfer returns false)
+//   - past either end of the pot (POT_MAX in ScaraConfig.h), so the arm could never be servoed there
+//   - closer than --margin mm to full reach or the y guard (warning only, the motors slow right down there)
+//   - not a readable "x y" / "x,y" line
+// Blank lines and lines starting with # or ; are skipped and don't count as points, indices start at 0.
+//
+// The file is read in blocks that worker threads parse and check on their own. Only a few blocks per thread are
+// in flight at once, so memory stays flat no matter how long the file is. Flagged points are written in file order.
+//
+// Build: g++ -O2 -pthread -o PathValidator tools/PathValidator.cpp
+// Run:   ./PathValidator path.xy [--margin mm] [--threads n] [--list flagged.txt]
+// Exits 1 if any point is out of reach, past a joint limit or unreadable.
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../WorkspaceMap.h"
+
+#define PATH_UNREACHABLE 1
+#define PATH_JOINT_LIMIT 2
+#define PATH_NEAR_SINGULAR 4
+#define PATH_BAD_LINE 8
+
+#define BLOCK_BYTES (1 << 20)
+
+struct Issue {
+  long index;  // within the block until it is written out
+  int flags;
+  float x, y;
+  float singularity;
+};
+
+struct Block {
+  long number;
+  std::string text;
+};
+
+struct BlockResult {
+  long points;
+  std::vector<Issue> issues;
+};
+
+// Parses and checks one block, indices are relative to the start of the block
+static void CheckBlock(const std::string& text, float margin, BlockResult& result) {
+  result.points = 0;
+  const char* p = text.c_str();
+  const char* end = p + text.size();
+  while (p < end) {
+    const char* next = (const char*)memchr(p, '\n', end - p);
+    if (!next) {
+      next = end;
+    }
+    while (p < next && (*p == ' ' || *p == '\t' || *p == '\r')) {
+      p++;
+    }
+    if (p == next || *p == '#' || *p == ';') {
+      p = next + 1;
+      continue;
+    }
+
+    Issue issue = {result.points++, 0, 0, 0, 0};
+    char* after;
+    issue.x = strtof(p, &after);
+    bool parsed = after != p;
+    p = after;
+    while (p < next && (*p == ' ' || *p == '\t' || *p == ',')) {
+      p++;
+    }
+    issue.y = strtof(p, &after);
+    parsed = parsed && after != p && after <= next;
+
+    if (!parsed) {
+      issue.flags = PATH_BAD_LINE;
+    }
+    else {
+      WorkspacePoint point = MeasureWorkspace<KindLadyArm>(issue.x, issue.y);
+      issue.singularity = point.singularity;
+      if (!point.reachable) {
+        issue.flags |= PATH_UNREACHABLE;
+      }
+      else {
+        int left = AngleToPot(point.theta);
+        int right = AngleToPot(point.phi);
+        if (left < 0 || left > POT_MAX || right < 0 || right > POT_MAX) {
+          issue.flags |= PATH_JOINT_LIMIT;
+        }
+        if (point.singularity < margin) {
+          issue.flags |= PATH_NEAR_SINGULAR;
+        }
+      }
+    }
+    if (issue.flags) {
+      result.issues.push_back(issue);
+    }
+    p = next + 1;
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s path.xy [--margin mm] [--threads n] [--list flagged.txt]\n", argv[0]);
+    return 2;
+  }
+  const char* path = argv[1];
+  float margin = 2;
+  int threads = (int)std::thread::hardware_concurrency();
+  const char* list = NULL;
+
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--margin")) margin = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--threads")) threads = atoi(argv[i+1]);
+    else if (!strcmp(argv[i], "--list")) list = argv[i+1];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  FILE* in = fopen(path, "rb");
+  if (!in) {
+    perror(path);
+    return 2;
+  }
+  FILE* out = NULL;
+  if (list) {
+    out = fopen(list, "w");
+    if (!out) {
+      perror(list);
+      return 2;
+    }
+    fprintf(out, "index,flags,x,y,singularity_mm\n");
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::mutex lock;
+  std::condition_variable changed;
+  std::deque<Block> pending;             // read but not checked yet
+  std::map<long, BlockResult> finished;  // checked but not written yet
+  bool reading = true;
+  const size_t inFlight = 2 * threads;
+
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&]() {
+      while (true) {
+        Block block;
+        {
+          std::unique_lock<std::mutex> guard(lock);
+          changed.wait(guard, [&]() { return !pending.empty() || !reading; });
+          if (pending.empty()) {
+            return;
+          }
+          block.number = pending.front().number;
+          block.text.swap(pending.front().text);
+          pending.pop_front();
+        }
+        changed.notify_all();
+
+        BlockResult result;
+        CheckBlock(block.text, margin, result);
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          finished[block.number].points = result.points;
+          finished[block.number].issues.swap(result.issues);
+        }
+        changed.notify_all();
+      }
+    }));
+  }
+
+  // Results are merged in block order so indices can be made absolute and the list comes out sorted
+  long blocks = 0, written = 0, points = 0;
+  long counts[4] = {0, 0, 0, 0};
+  long first[4] = {-1, -1, -1, -1};
+  long firstError = -1;
+  auto writeFinished = [&](std::unique_lock<std::mutex>& guard) {
+    while (!finished.empty() && finished.begin()->first == written) {
+      BlockResult result;
+      result.points = finished.begin()->second.points;
+      result.issues.swap(finished.begin()->second.issues);
+      finished.erase(finished.begin());
+      guard.unlock();
+      for (size_t i = 0; i < result.issues.size(); i++) {
+        Issue& issue = result.issues[i];
+        issue.index += points;
+        for (int bit = 0; bit < 4; bit++) {
+          if (issue.flags & (1 << bit)) {
+            counts[bit]++;
+            if (first[bit] < 0) {
+              first[bit] = issue.index;
+            }
+          }
+        }
+        if (firstError < 0 && (issue.flags & ~PATH_NEAR_SINGULAR)) {
+          firstError = issue.index;
+        }
+        if (out) {
+          fprintf(out, "%ld,%d,%.4f,%.4f,%.3f\n", issue.index, issue.flags, issue.x, issue.y, issue.singularity);
+        }
+      }
+      points += result.points;
+      written++;
+      guard.lock();
+    }
+  };
+
+  // Blocks end on a line break, whatever is left over starts the next block
+  std::string carry;
+  std::vector<char> buffer(BLOCK_BYTES);
+  while (true) {
+    size_t got = fread(buffer.data(), 1, buffer.size(), in);
+    if (got == 0 && carry.empty()) {
+      break;
+    }
+    Block block;
+    block.number = blocks++;
+    block.text.swap(carry);
+    block.text.append(buffer.data(), got);
+    if (got > 0) {
+      size_t cut = block.text.rfind('\n');
+      if (cut != std::string::npos) {
+        carry.assign(block.text, cut + 1, std::string::npos);
+        block.text.resize(cut + 1);
+      }
+      else {
+        carry.swap(block.text);
+        blocks--;
+        continue;
+      }
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [&]() { writeFinished(guard); return pending.size() + finished.size() < inFlight; });
+    pending.push_back(Block());
+    pending.back().number = block.number;
+    pending.back().text.swap(block.text);
+    guard.unlock();
+    changed.notify_all();
+    if (got == 0) {
+      break;
+    }
+  }
+  fclose(in);
+
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    reading = false;
+    changed.notify_all();
+    changed.wait(guard, [&]() { writeFinished(guard); return written == blocks; });
+  }
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+  if (out) {
+    fclose(out);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const char* names[4] = {"out of reach", "past a joint limit", "near a singularity", "unreadable"};
+  printf("%ld points checked in %.2f s (%.1f M points/s, %d threads)\n", points, seconds, points / seconds / 1e6,
+         threads);
+  for (int bit = 0; bit < 4; bit++) {
+    if (counts[bit]) {
+      printf("  %ld %s, first at index %ld\n", counts[bit], names[bit], first[bit]);
+    }
+  }
+  if (firstError >= 0) {
+    printf("REJECTED: first bad point at index %ld\n", firstError);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
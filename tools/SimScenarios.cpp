@@ -0,0 +1,283 @@
+// Runs the motion and homing code against ArmSim.h's motors in virtual time, many scenarios back to back, for CI
+//   rates    each ProfileType ramps both motors up to a rate, cruises and stops, going up a rate at a time until
+//            the motors miss steps. The highest rate that didn't is what that profile gets out of these motors.
+//   moves    random chains of CoordinatedMotion segments between poses in the workspace, at random rates up to
+//            MAX_STEP_RATE with MOTION_PROFILE. The motors have to get to every pose without missing a step, and
+//            without the linkage ever refusing a move.
+//   homing   Homing.h on the left motor from random angles with random HES fields, with a hard stop low down where
+//            it would run into the right arm, so the blind sweep rams it like README.md says it might, and another
+//            behind the HES. The HES is on a full step like README.md has it. Homing has to end up less than a full
+//            step from the HES, or fail if it started too far behind it to be found.
+//   damping  ArmSim's motor damping is a guess, not a measurement, and with too little of it the uneven minor axis
+//            steps of CoordinatedMotion and the homing sweeps do miss. So a quarter as many moves and homings again
+//            with the damping taken down by sqrt(2) at a time until one fails, which gives how far under the guess
+//            the real motors could be and still get by.
+// Exits 1 if MOTION_PROFILE misses steps at MAX_STEP_RATE, any move or homing scenario fails, or they don't all
+// pass with the damping down by SIM_DAMPING_MARGIN, so a change to the profiles, the step timing, the coil tables
+// or homing that would lose steps on the arm shows up without one, and so does one that only gets by thanks to
+// the guess.
+//
+// Build: g++ -O2 -o SimScenarios tools/SimScenarios.cpp
+// Run:   ./SimScenarios [scenarios of each kind] [--seed n] [--csv results.csv]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "../Hal.h"
+#include "../CoordinatedMotion.h"
+#include "../Homing.h"
+#include "ArmSim.h"
+
+#define STEP_RADIANS (2 * M_PI / STEPS_PER_REV)
+#define FULL_STEP_RADIANS (STEP_RADIANS * STEP_DIVISION)
+#define SETTLE_US 100000
+#define HES_PIN 2
+#define SIM_DAMPING_MARGIN 2   // the scenarios have to pass with the damping divided by this
+
+FILE* Csv = 0;
+long Scenarios = 0;
+
+void Record(const char* kind, long index, double value, bool good) {
+  Scenarios++;
+  if (Csv) {
+    fprintf(Csv, "%s,%ld,%.4f,%d\n", kind, index, value, good ? 1 : 0);
+  }
+}
+
+// Runs until both motors are done with everything queued, then lets them settle
+template <class Driver>
+void RunOut(Driver& driver) {
+  while (!driver.Idle()) {
+    HalAdvance(1000);
+  }
+  HalAdvance(SETTLE_US);
+}
+
+struct EngineDone {
+  StepEngine<>& engine;
+  bool Idle() {
+    return this->engine.Idle(STEP_LEFT) && this->engine.Idle(STEP_RIGHT);
+  }
+};
+
+// One move of both motors to rate and back down again with the given profile type, true if no steps were missed
+bool RateScenario(uint8_t type, long rate) {
+  HalReset();
+  ArmSim sim;
+  sim.linkage = false;  // motors on the bench
+  sim.Begin();
+  ScaraStepper left(3,5,4,6,A0), right(7,9,8,10,A1);
+  ProfileLimits limits = left.printProfile();
+  limits.type = type;
+  left.setProfile(limits);
+  right.setProfile(limits);
+  StepEngine<> engine(left, right);
+  engine.Begin();
+  left.Advance(0);
+  right.Advance(0);
+  HalAdvance(SETTLE_US);
+
+  // Long enough to get up to rate and cruise there for 200 ms
+  int steps = (int)min(30000L, rate * rate / MAX_ACCEL + rate / 5);
+  engine.Push(STEP_LEFT, steps, 1000000UL / rate);
+  engine.Push(STEP_RIGHT, -steps, 1000000UL / rate);
+  EngineDone done = {engine};
+  RunOut(done);
+  engine.End();
+  sim.End();
+  return sim.printMissed(0) == 0 && sim.printMissed(1) == 0;
+}
+
+// Highest rate the profile type ran at without missing steps, going up in eighths of MAX_STEP_RATE
+long RateSweep(uint8_t type) {
+  long best = 0;
+  long top = min(3L * MAX_STEP_RATE, 1000000L / STEP_TICK_US);
+  for (long rate = MAX_STEP_RATE / 8; rate <= top; rate += MAX_STEP_RATE / 8) {
+    bool good = RateScenario(type, rate);
+    Record(type == PROFILE_CONSTANT ? "constant" : type == PROFILE_TRAPEZOID ? "trapezoid" : "scurve", rate, rate,
+           good);
+    if (!good) {
+      break;
+    }
+    best = rate;
+  }
+  return best;
+}
+
+// A random pose in the workspace, as arm angles
+void RandomPose(std::mt19937& rng, float& theta, float& phi) {
+  std::uniform_real_distribution<float> x(-60, 110), y(KindLadyArm::MinY + 20, 160);
+  while (!CartesianTransfer(x(rng), y(rng), theta, phi)) {
+  }
+}
+
+// A chain of segments through random poses, true if the motors got to each of them
+bool MoveScenario(long index, std::mt19937& rng, float damping = 1, bool quiet = false) {
+  HalReset();
+  ArmSim sim(rng());
+  sim.ScaleDamping(damping);
+  float theta, phi;
+  RandomPose(rng, theta, phi);
+  sim.motors[0].start = theta;
+  sim.motors[1].start = phi;
+  sim.Begin();
+  ScaraStepper left(3,5,4,6,A0), right(7,9,8,10,A1);
+  CoordinatedMotion<> motion(left, right);
+  motion.Begin();
+
+  std::uniform_real_distribution<float> rate(START_STEP_RATE, MAX_STEP_RATE);
+  double worst = 0;
+  bool good = true;
+  for (int segment = 0; segment < 4 && good; segment++) {
+    RandomPose(rng, theta, phi);
+    // Advance(1) turns the arm angle down
+    long l = lround((sim.motors[0].start - theta) * STEPS_PER_RADIAN);
+    long r = lround((sim.motors[1].start - phi) * STEPS_PER_RADIAN);
+    long steps = max(labs(l - motion.printPlanned(STEP_LEFT)), labs(r - motion.printPlanned(STEP_RIGHT)));
+    motion.MoveTo(l, r, (uint32_t)(steps * 1e6f / rate(rng)));
+    RunOut(motion);
+    double error = max(fabs(sim.printAngle(0) - theta), fabs(sim.printAngle(1) - phi)) / STEP_RADIANS;
+    worst = max(worst, error);
+    good = sim.printMissed(0) == 0 && sim.printMissed(1) == 0 && sim.blocked == 0 && error < STEP_DIVISION;
+  }
+  motion.End();
+  sim.End();
+  if (quiet) {
+    return good;
+  }
+  Record("move", index, worst, good);
+  if (!good) {
+    printf("  move %ld: missed %ld/%ld steps, linkage blocked %ld ticks, %.2f steps off\n", index,
+           sim.printMissed(0), sim.printMissed(1), sim.blocked, worst);
+  }
+  return good;
+}
+
+// Homing from a random angle, true if it ended up where it should (or failed where it should)
+bool HomingScenario(long index, std::mt19937& rng, float damping = 1, bool quiet = false) {
+  HalReset();
+  ArmSim sim(rng());
+  sim.ScaleDamping(damping);
+  std::uniform_real_distribution<float> width(0.02f, 0.07f), start(-3.5f, 1.7f);
+  sim.hes_width = width(rng);
+  // The HES comes on this far out from the middle of the field, so the blind sweep finds it from that much further
+  float reach = sim.hes_width * sqrt(-log(sim.hes_on));
+  float blind = HOMING_BLIND_STEPS * STEP_RADIANS + reach;
+  float offset;
+  do {
+    offset = lroundf(start(rng) / FULL_STEP_RADIANS) * FULL_STEP_RADIANS;  // from the HES, positive is behind
+  } while (fabs(offset - blind) < 2 * FULL_STEP_RADIANS);
+  sim.motors[0].start = sim.hes_angle + offset;
+  sim.motors[0].low = 0.35;                     // the right arm
+  sim.motors[0].high = sim.hes_angle + 2.2;     // and the frame behind the HES, so it can't go all the way round
+  sim.motors[0].hes = HES_PIN;
+  sim.linkage = false;
+  sim.Begin();
+  ScaraStepper left(3,5,4,6,A0);
+
+  bool found = Homing(left, HES_PIN, -1);  // towards the HES is up in angle, Advance(-1)
+  bool expected = offset < blind;
+  double error = remainder(sim.printAngle(0) - sim.hes_angle, 2 * M_PI) / FULL_STEP_RADIANS;
+  bool good = found == expected && (!found || fabs(error) < 1);
+  sim.End();
+  if (quiet) {
+    return good;
+  }
+  Record("homing", index, error, good);
+  if (!good) {
+    printf("  homing %ld: started %.1f degrees from the HES, field %.3f rad, %s, %.2f full steps off\n", index,
+           offset * 180 / M_PI, sim.hes_width, found ? "found" : "not found", error);
+  }
+  return good;
+}
+
+// Lowest fraction of ArmSim's damping that count moves and count homings still all pass at
+float DampingSweep(long count, uint32_t seed) {
+  float passed = 0;
+  for (float factor = 1; factor > 0.05f; factor /= 1.4142136f) {
+    std::mt19937 rng(seed);
+    long bad = 0;
+    for (long i = 0; i < count; i++) {
+      bad += !MoveScenario(i, rng, factor, true);
+      bad += !HomingScenario(i, rng, factor, true);
+    }
+    Record("damping", 0, factor, bad == 0);
+    if (bad) {
+      break;
+    }
+    passed = factor;
+  }
+  return passed;
+}
+
+int main(int argc, char** argv) {
+  long count = 200;
+  uint32_t seed = 1;
+  const char* csvPath = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = atol(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csvPath = argv[++i];
+    }
+    else {
+      count = atol(argv[i]);
+    }
+  }
+  if (csvPath) {
+    Csv = fopen(csvPath, "w");
+    if (!Csv) {
+      fprintf(stderr, "can't write %s\n", csvPath);
+      return 1;
+    }
+    fprintf(Csv, "kind,index,value,good\n");
+  }
+  HalSerialOut = 0;
+  std::mt19937 rng(seed);
+  auto began = std::chrono::steady_clock::now();
+  bool failed = false;
+
+  printf("STEP_DIVISION %d, MAX_STEP_RATE %d, MAX_ACCEL %ld, seed %u\n", STEP_DIVISION, MAX_STEP_RATE,
+         (long)MAX_ACCEL, seed);
+  const uint8_t types[] = {PROFILE_CONSTANT, PROFILE_TRAPEZOID, PROFILE_SCURVE};
+  const char* names[] = {"constant", "trapezoid", "scurve"};
+  for (int t = 0; t < 3; t++) {
+    long best = RateSweep(types[t]);
+    bool short_of = types[t] == MOTION_PROFILE && best < MAX_STEP_RATE;
+    failed = failed || short_of;
+    printf("rates:  %-9s  no missed steps up to %6ld steps/s%s\n", names[t], best,
+           short_of ? "  FAILED, under MAX_STEP_RATE" : types[t] == MOTION_PROFILE ? "  (MOTION_PROFILE)" : "");
+  }
+
+  long bad = 0;
+  for (long i = 0; i < count; i++) {
+    bad += !MoveScenario(i, rng);
+  }
+  printf("moves:  %ld of %ld reached every pose without missing a step\n", count - bad, count);
+  failed = failed || bad;
+
+  bad = 0;
+  for (long i = 0; i < count; i++) {
+    bad += !HomingScenario(i, rng);
+  }
+  printf("homing: %ld of %ld as expected\n", count - bad, count);
+  failed = failed || bad;
+
+  float lowest = DampingSweep(count / 4 > 10 ? count / 4 : 10, seed);
+  bool thin = lowest == 0 || 1 / lowest < SIM_DAMPING_MARGIN - 0.01f;
+  failed = failed || thin;
+  printf("damping: moves and homing still pass at %.2f of it (%.1e N m s), a margin of %.1fx%s\n", lowest,
+         DefaultMotorModel().damping * lowest, lowest > 0 ? 1 / lowest : 0.0f,
+         thin ? "  FAILED, under SIM_DAMPING_MARGIN" : "");
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - began).count();
+  printf("%ld scenarios in %.1f s, %.0f a minute: %s\n", Scenarios, seconds, Scenarios / seconds * 60,
+         failed ? "FAILED" : "passed");
+  if (Csv) {
+    fclose(Csv);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// Decodes a capture of the sketch's telemetry stream (Telemetry.h) into CSV, or into one binary file per column
+// The capture is just the bytes that came out of the serial port, e.g. `cat /dev/ttyACM0 > capture.bin` with the
+// port set to 115200 raw, or HostSketch --serial. Frames are found by their sync bytes and kept only if the CRC
+// matches, so a capture that starts mid frame or has noise in it still decodes. micros() wraps every 71 minutes
+// on the board, the decoded time doesn't.
+//
+// CSV goes to stdout (or --csv file): time_us,sequence,left_angle,left_goal,right_angle,right_goal,left_steps,...
+// --columns dir writes dir/<column>.bin, each a plain little endian array (time_us int64, sequence uint16, angles
+// and goals int16, steps int32), plus dir/columns.txt listing name, type and length, which numpy.fromfile, pandas
+// or anything else columnar reads without parsing text.
+// The counts of frames, bad CRCs and sequence gaps (frames the board dropped or the capture lost) go to stderr.
+//
+// Build: g++ -O2 -o TelemetryDecode tools/TelemetryDecode.cpp
+// Run:   ./TelemetryDecode capture.bin [--csv out.csv | --columns dir]      (- reads stdin)
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../Telemetry.h"
+
+struct Columns {
+  std::vector<int64_t> time;
+  std::vector<uint16_t> sequence;
+  std::vector<int16_t> angle[2], goal[2];
+  std::vector<int32_t> steps[2];
+};
+
+template <class T>
+bool WriteColumn(const std::string& dir, const char* name, const char* type, const std::vector<T>& column,
+                 FILE* schema) {
+  std::string path = dir + "/" + name + ".bin";
+  FILE* out = fopen(path.c_str(), "wb");
+  if (!out) {
+    fprintf(stderr, "can't write %s\n", path.c_str());
+    return false;
+  }
+  fwrite(column.data(), sizeof(T), column.size(), out);
+  fclose(out);
+  fprintf(schema, "%s %s %zu\n", name, type, column.size());
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* inPath = 0;
+  const char* csvPath = 0;
+  const char* columnsDir = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csvPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--columns") && i + 1 < argc) {
+      columnsDir = argv[++i];
+    }
+    else {
+      inPath = argv[i];
+    }
+  }
+  if (!inPath) {
+    fprintf(stderr, "usage: %s capture.bin [--csv out.csv | --columns dir]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = strcmp(inPath, "-") ? fopen(inPath, "rb") : stdin;
+  if (!in) {
+    fprintf(stderr, "can't read %s\n", inPath);
+    return 1;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    bytes.insert(bytes.end(), chunk, chunk + got);
+  }
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  Columns columns;
+  long bad = 0, gaps = 0, missing = 0;
+  int64_t wraps = 0;
+  uint32_t lastTime = 0;
+  size_t i = 0;
+  while (i + sizeof(TelemetryFrame) <= bytes.size()) {
+    TelemetryFrame frame;
+    memcpy(&frame, &bytes[i], sizeof(frame));
+    if (frame.sync != TELEMETRY_SYNC) {
+      i++;
+      continue;
+    }
+    if (frame.crc != TelemetryCrc(&bytes[i], offsetof(TelemetryFrame, crc))) {
+      bad++;
+      i++;  // sync bytes inside a frame, or a damaged frame, look again from the next byte
+      continue;
+    }
+    i += sizeof(frame);
+
+    if (!columns.sequence.empty()) {
+      uint16_t skipped = frame.sequence - columns.sequence.back() - 1;
+      if (skipped) {
+        gaps++;
+        missing += skipped;
+      }
+      if (frame.time < lastTime) {
+        wraps++;
+      }
+    }
+    lastTime = frame.time;
+    columns.time.push_back((wraps << 32) + frame.time);
+    columns.sequence.push_back(frame.sequence);
+    for (int m = 0; m < 2; m++) {
+      columns.angle[m].push_back(frame.angle[m]);
+      columns.goal[m].push_back(frame.goal[m]);
+      columns.steps[m].push_back(frame.steps[m]);
+    }
+  }
+
+  size_t frames = columns.sequence.size();
+  fprintf(stderr, "%zu frames from %zu bytes, %ld bad CRCs, %ld gaps (%ld frames missing)\n", frames, bytes.size(),
+          bad, gaps, missing);
+  if (frames > 1) {
+    double seconds = (columns.time.back() - columns.time.front()) / 1e6;
+    fprintf(stderr, "%.2f s, %.1f frames/s\n", seconds, (frames - 1) / seconds);
+  }
+
+  if (columnsDir) {
+    std::string dir = columnsDir;
+    FILE* schema = fopen((dir + "/columns.txt").c_str(), "w");
+    if (!schema) {
+      fprintf(stderr, "can't write %s/columns.txt, does the directory exist?\n", columnsDir);
+      return 1;
+    }
+    bool good = WriteColumn(dir, "time_us", "int64", columns.time, schema) &&
+                WriteColumn(dir, "sequence", "uint16", columns.sequence, schema) &&
+                WriteColumn(dir, "left_angle", "int16", columns.angle[0], schema) &&
+                WriteColumn(dir, "left_goal", "int16", columns.goal[0], schema) &&
+                WriteColumn(dir, "right_angle", "int16", columns.angle[1], schema) &&
+                WriteColumn(dir, "right_goal", "int16", columns.goal[1], schema) &&
+                WriteColumn(dir, "left_steps", "int32", columns.steps[0], schema) &&
+                WriteColumn(dir, "right_steps", "int32", columns.steps[1], schema);
+    fclose(schema);
+    return good ? 0 : 1;
+  }
+
+  FILE* out = csvPath ? fopen(csvPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "can't write %s\n", csvPath);
+    return 1;
+  }
+  fprintf(out, "time_us,sequence,left_angle,left_goal,right_angle,right_goal,left_steps,right_steps\n");
+  for (size_t f = 0; f < frames; f++) {
+    fprintf(out, "%lld,%u,%d,%d,%d,%d,%ld,%ld\n", (long long)columns.time[f], columns.sequence[f],
+            columns.angle[0][f], columns.goal[0][f], columns.angle[1][f], columns.goal[1][f],
+            (long)columns.steps[0][f], (long)columns.steps[1][f]);
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+// Turns the Trace.h events in a serial capture into Chrome trace JSON, for chrome://tracing or ui.perfetto.dev
+// The capture is the bytes that came out of the port after sending the sketch a 'T' command frame (XYStream.h), e.g.
+// `cat /dev/ttyACM0 > capture.bin` in one terminal and `printf '\xa9\x5a\x54\x08\xd8' > /dev/ttyACM0` in another,
+// or HostSketch --serial built with -DTRACE.
+// Telemetry frames and anything else in it are skipped, and if it holds several dumps the events they share are
+// only counted once (every event is numbered from when the board started).
+// What shows up, times in us from the first event:
+//   left motor, right motor   an instant per step, with the position and the us since that motor's step before
+//   counters                  each motor's position and step interval, each queue's depth and each pot's value, so
+//                             a stall is a flat position with an interval spike on one motor and not the other
+//   serial                    a slice per write, as long as the bytes take at --baud
+//   homing                    an instant per HES edge
+// How many events there were, and how many had already been overwritten by the dump, goes to stderr.
+//
+// Build: g++ -O2 -o TraceChrome tools/TraceChrome.cpp
+// Run:   ./TraceChrome capture.bin [--out trace.json] [--baud 115200]     (- reads stdin, JSON to stdout)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "../Trace.h"
+
+#define TID_LEFT 0
+#define TID_RIGHT 1
+#define TID_SERIAL 2
+#define TID_HOMING 3
+
+const char* QueueName(uint8_t queue) {
+  switch (queue) {
+    case TRACE_QUEUE_MOTION: return "motion queue";
+    case TRACE_QUEUE_LEFT: return "left queue";
+    case TRACE_QUEUE_RIGHT: return "right queue";
+    case TRACE_QUEUE_WAYPOINTS: return "waypoint queue";
+    default: return "queue";
+  }
+}
+
+const char* MotorName(uint8_t motor) {
+  return motor == 0 ? "left" : "right";  // STEP_LEFT
+}
+
+int main(int argc, char** argv) {
+  const char* inPath = 0;
+  const char* outPath = 0;
+  long baud = 115200;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      outPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = atol(argv[++i]);
+    }
+    else {
+      inPath = argv[i];
+    }
+  }
+  if (!inPath || baud <= 0) {
+    fprintf(stderr, "usage: %s capture.bin [--out trace.json] [--baud 115200]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = strcmp(inPath, "-") ? fopen(inPath, "rb") : stdin;
+  if (!in) {
+    fprintf(stderr, "can't read %s\n", inPath);
+    return 1;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    bytes.insert(bytes.end(), chunk, chunk + got);
+  }
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  std::map<uint32_t, TraceRecord> events;  // by event number
+  long bad = 0, dumps = 0;
+  uint32_t recorded = 0;
+  size_t i = 0;
+  while (i + sizeof(TraceHeader) + 2 <= bytes.size()) {
+    TraceHeader header;
+    memcpy(&header, &bytes[i], sizeof(header));
+    size_t length = sizeof(header) + header.count * sizeof(TraceRecord);
+    if (header.sync != TRACE_SYNC || header.count > TRACE_BATCH || i + length + 2 > bytes.size()) {
+      i++;
+      continue;
+    }
+    uint16_t crc;
+    memcpy(&crc, &bytes[i + length], 2);
+    if (crc != TelemetryCrc(&bytes[i], length)) {
+      bad++;
+      i++;
+      continue;
+    }
+    for (uint8_t e = 0; e < header.count; e++) {
+      memcpy(&events[header.first + e], &bytes[i + sizeof(header) + e * sizeof(TraceRecord)], sizeof(TraceRecord));
+    }
+    if (header.count == 0) {
+      dumps++;
+      recorded = header.first;
+    }
+    i += length + 2;
+  }
+
+  if (events.empty()) {
+    fprintf(stderr, "no trace events in %zu bytes (%ld bad CRCs), is the sketch built with TRACE?\n", bytes.size(),
+            bad);
+    return 1;
+  }
+  uint32_t first = events.begin()->first;
+  uint32_t last = events.rbegin()->first;
+  fprintf(stderr, "%zu events (%u to %u) from %ld dumps, %ld bad CRCs, %u recorded in all, %u overwritten first\n",
+          events.size(), first, last, dumps, bad, recorded, first);
+  if (last - first + 1 != events.size()) {
+    fprintf(stderr, "%zu events missing in between\n", (size_t)(last - first + 1) - events.size());
+  }
+
+  FILE* out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "can't write %s\n", outPath);
+    return 1;
+  }
+  fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"arm\"}}");
+  const char* threads[] = {"left motor", "right motor", "serial", "homing"};
+  for (int t = 0; t < 4; t++) {
+    fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            t, threads[t]);
+  }
+
+  int64_t wraps = 0;
+  uint32_t lastTime = events.begin()->second.time;
+  uint32_t startTime = lastTime;
+  int64_t position[2] = {0, 0};
+  int16_t lastStep[2] = {0, 0};
+  bool stepped[2] = {false, false};
+  int64_t stepTime[2] = {0, 0};
+  for (std::map<uint32_t, TraceRecord>::iterator e = events.begin(); e != events.end(); ++e) {
+    const TraceRecord& event = e->second;
+    if (event.time < lastTime && lastTime - event.time > 0x80000000UL) {
+      wraps++;  // micros() wrapped, every 71 minutes
+    }
+    lastTime = event.time;
+    int64_t ts = (wraps << 32) + event.time - startTime;
+    switch (event.type) {
+      case TRACE_STEP: {
+        uint8_t m = event.arg & 1;
+        position[m] = stepped[m] ? position[m] + (int16_t)(event.value - lastStep[m]) : event.value;
+        int64_t interval = stepped[m] ? ts - stepTime[m] : 0;
+        lastStep[m] = event.value;
+        stepTime[m] = ts;
+        stepped[m] = true;
+        fprintf(out, ",\n{\"name\": \"step\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %lld, \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"position\": %lld, \"interval_us\": %lld}}", (long long)ts, m == 0 ? TID_LEFT :
+                TID_RIGHT, (long long)position[m], (long long)interval);
+        fprintf(out, ",\n{\"name\": \"%s position\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, "
+                "\"args\": {\"steps\": %lld}}", MotorName(m), (long long)ts, (long long)position[m]);
+        if (interval > 0) {
+          fprintf(out, ",\n{\"name\": \"%s step interval\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, "
+                  "\"args\": {\"us\": %lld}}", MotorName(m), (long long)ts, (long long)interval);
+        }
+        break;
+      }
+      case TRACE_ADC:
+        fprintf(out, ",\n{\"name\": \"pot %u\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, \"args\": {\"counts\": %d}}",
+                event.arg, (long long)ts, event.value);
+        break;
+      case TRACE_HES:
+        fprintf(out, ",\n{\"name\": \"HES pin %u %s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %lld, \"pid\": 1, "
+                "\"tid\": %d}", event.arg, event.value ? "on" : "off", (long long)ts, TID_HOMING);
+        break;
+      case TRACE_PUSH:
+      case TRACE_POP:
+        fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"C\", \"ts\": %lld, \"pid\": 1, \"args\": {\"depth\": %d}}",
+                QueueName(event.arg), (long long)ts, event.value);
+        break;
+      case TRACE_TX:
+        fprintf(out, ",\n{\"name\": \"tx\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %.1f, \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"bytes\": %d}}", (long long)ts, event.value * 10e6 / baud, TID_SERIAL, event.value);
+        break;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,171 @@
+// Generates the workspace map used by WorkspaceSpeed / WorkspaceClip (see WorkspaceMap.h)
+//
+// Build: g++ -O2 -pthread -o WorkspaceMapGen tools/WorkspaceMapGen.cpp
+// Run:   ./WorkspaceMapGen [--step mm] [--threads n] [--pgm prefix] [--header file.h | --binary file.bin]
+//
+// --pgm writes three greyscale images, one pixel per cell with +y up, to look at the area by eye:
+//   prefix-reach.pgm        white where the whole cell can be reached
+//   prefix-singularity.pgm  distance from the cell centre to full reach / the y guard, white = 20 mm or more
+//   prefix-speed.pgm        top speed in the worst direction, white = fastest cell in the map
+// The header holds a PROGMEM array plus a ready to use "const WorkspaceMap KindLadyWorkspace".
+// The binary blob is "KLWM", uint16 version, uint16 cols, uint16 rows, float x0, y0, step, speed_scale,
+// then the cells, all little endian.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../WorkspaceMap.h"
+
+static bool writePgm(const char* prefix, const char* name, const WorkspaceMap& map, const std::vector<float>& values,
+                     float white) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s-%s.pgm", prefix, name);
+  FILE* out = fopen(path, "wb");
+  if (!out) {
+    perror(path);
+    return false;
+  }
+  fprintf(out, "P5\n%u %u\n255\n", map.cols, map.rows);
+  for (int row = map.rows - 1; row >= 0; row--) {
+    for (int col = 0; col < map.cols; col++) {
+      float v = values[row * map.cols + col] / white;
+      fputc((int)(fmax(0.0f, fmin(1.0f, v)) * 255 + 0.5f), out);
+    }
+  }
+  fclose(out);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  float step = 1;
+  int threads = (int)std::thread::hardware_concurrency();
+  const char* pgm = NULL;
+  const char* header = NULL;
+  const char* binary = NULL;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--step")) step = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--threads")) threads = atoi(argv[i+1]);
+    else if (!strcmp(argv[i], "--pgm")) pgm = argv[i+1];
+    else if (!strcmp(argv[i], "--header")) header = argv[i+1];
+    else if (!strcmp(argv[i], "--binary")) binary = argv[i+1];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  // Same bounding box as JointTableGen
+  WorkspaceMap map;
+  map.x0 = KindLadyArm::Base - KindLadyArm::RightReach;
+  map.y0 = KindLadyArm::MinY;
+  map.step = step;
+  map.cols = (uint16_t)((KindLadyArm::LeftReach - map.x0) / step) + 1;
+  map.rows = (uint16_t)((KindLadyArm::LeftReach - map.y0) / step) + 1;
+  int count = map.cols * map.rows;
+
+  // First pass: cell centres, for the images and to pick the speed scale
+  std::vector<float> reach(count), singularity(count), speed(count);
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&, t]() {
+      for (int i = t; i < count; i += threads) {
+        WorkspacePoint point = MeasureWorkspace<KindLadyArm>(map.x0 + (i % map.cols + 0.5f) * step,
+                                                             map.y0 + (i / map.cols + 0.5f) * step);
+        reach[i] = point.reachable;
+        singularity[i] = point.singularity;
+        speed[i] = point.speed;
+      }
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+  pool.clear();
+
+  float fastest = 0;
+  for (int i = 0; i < count; i++) {
+    fastest = fmax(fastest, speed[i]);
+  }
+  map.speed_scale = fastest / 255;
+
+  // Second pass: the conservative per-cell bytes, in bands of rows
+  std::vector<uint8_t> cells(count);
+  int band = (map.rows + threads - 1) / threads;
+  for (int first = 0; first < map.rows; first += band) {
+    int last = first + band < map.rows ? first + band : map.rows;
+    pool.push_back(std::thread([&, first, last]() {
+      BuildWorkspaceRows<KindLadyArm>(map, cells.data(), first, last);
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+  map.cells = cells.data();
+  map.progmem = false;
+
+  int reachable = 0;
+  float slowest = INFINITY;
+  for (int i = 0; i < count; i++) {
+    if (cells[i]) {
+      reachable++;
+      slowest = fmin(slowest, cells[i] * map.speed_scale);
+    }
+  }
+  fprintf(stderr, "map %dx%d at %.2f mm on %d threads, %d bytes\n", map.cols, map.rows, step, threads, count);
+  fprintf(stderr, "%d cells fully reachable (%.0f mm^2), top speed %.1f mm/s, slowest reachable cell %.2f mm/s\n",
+          reachable, reachable * step * step, fastest, slowest);
+
+  if (pgm) {
+    if (!writePgm(pgm, "reach", map, reach, 1) || !writePgm(pgm, "singularity", map, singularity, 20)
+        || !writePgm(pgm, "speed", map, speed, fastest)) {
+      return 1;
+    }
+  }
+
+  if (header) {
+    FILE* out = fopen(header, "w");
+    if (!out) {
+      perror(header);
+      return 1;
+    }
+    fprintf(out, "// Generated by tools/WorkspaceMapGen.cpp, do not edit\n");
+    fprintf(out, "// step %.3f mm, top speed %.1f mm/s, %d bytes\n", step, fastest, count);
+    fprintf(out, "#pragma once\n#include \"WorkspaceMap.h\"\n\n");
+    fprintf(out, "static const uint8_t KindLadyWorkspaceCells[] PROGMEM = {");
+    for (int i = 0; i < count; i++) {
+      if (i % 16 == 0) {
+        fprintf(out, "\n  ");
+      }
+      fprintf(out, "%u,", cells[i]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "const WorkspaceMap KindLadyWorkspace = {%.6ff, %.6ff, %.6ff, %.6ef, %u, %u, "
+            "KindLadyWorkspaceCells, true};\n",
+            map.x0, map.y0, map.step, map.speed_scale, map.cols, map.rows);
+    fclose(out);
+  }
+
+  if (binary) {
+    FILE* out = fopen(binary, "wb");
+    if (!out) {
+      perror(binary);
+      return 1;
+    }
+    uint16_t version = 1;
+    float floats[4] = {map.x0, map.y0, map.step, map.speed_scale};
+    fwrite("KLWM", 1, 4, out);
+    fwrite(&version, 2, 1, out);
+    fwrite(&map.cols, 2, 1, out);
+    fwrite(&map.rows, 2, 1, out);
+    fwrite(floats, 4, 4, out);
+    fwrite(cells.data(), 1, cells.size(), out);
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+// Streams XY waypoints to the sketch over a serial port (XYStream.h), keeping its queue full, and reports segments/s
+// Waits for the board's first ack (opening the port resets an Uno, so that can take a couple of seconds), then sends
+// whenever the acks give it credit, see XYSender.h. Prints a line a second with how many waypoints the board has
+// turned into motion segments and at what rate, and the sustained rate over the whole run at the end. The telemetry
+// frames that come back in between are skipped (capture the port with TelemetryDecode instead if they're wanted).
+// With --dump it asks for the board's Scheduler.h task table at the end and prints it, with the Instrument.h
+// counters before it when the sketch is built with INSTRUMENT.
+//
+// Build: g++ -O2 -o XYSend tools/XYSend.cpp
+// Run:   ./XYSend /dev/ttyACM0 [circle|path.txt] [--laps n] [--feed mm/s] [--baud 115200]
+//                 [--dump]
+//        (path.txt has a waypoint a line, "x y" or "x y feed" in mm and mm/s)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "XYSender.h"
+
+uint64_t NowUs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+speed_t BaudConstant(long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+  }
+}
+
+int OpenPort(const char* path, long baud) {
+  int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) {
+    fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  termios tty;
+  tcgetattr(fd, &tty);
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, BaudConstant(baud));
+  cfsetospeed(&tty, BaudConstant(baud));
+  tty.c_cflag |= CLOCAL | CREAD;
+  if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+    fprintf(stderr, "can't set up %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+// Sends the '?' command frame that has the sketch print its Instrument.h counters and task table and prints them,
+// frames and all else skipped
+bool Dump(int fd) {
+  XYCommand command = XYCommandFrame('?');
+  if (write(fd, &command, sizeof(command)) != (ssize_t)sizeof(command)) {
+    return false;
+  }
+  std::string text;
+  uint64_t until = NowUs() + 2000000;
+  while (NowUs() < until) {
+    pollfd p = {fd, POLLIN, 0};
+    poll(&p, 1, 10);
+    char bytes[256];
+    ssize_t got;
+    while ((got = read(fd, bytes, sizeof(bytes))) > 0) {
+      text.append(bytes, got);
+    }
+    size_t last = text.find("# scheduler");
+    size_t end = last == std::string::npos ? last : text.find("# end", last);
+    if (end != std::string::npos) {
+      size_t begin = text.rfind("# instrument", last);
+      begin = begin == std::string::npos ? last : begin;
+      fwrite(text.data() + begin, 1, end + 5 - begin, stdout);
+      printf("\n");
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char** argv) {
+  const char* port = 0;
+  const char* source = "circle";
+  int laps = 3;
+  float feed = 0;  // the sketch's DEFAULT_FEEDRATE
+  long baud = 115200;
+  bool dump = false;
+  int positional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--laps") && i + 1 < argc) {
+      laps = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--feed") && i + 1 < argc) {
+      feed = atof(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = atol(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--dump")) {
+      dump = true;
+    }
+    else if (positional++ == 0) {
+      port = argv[i];
+    }
+    else {
+      source = argv[i];
+    }
+  }
+  if (!port || BaudConstant(baud) == B0) {
+    fprintf(stderr, "usage: %s /dev/ttyACM0 [circle|path.txt] [--laps n] [--feed mm/s] [--baud 115200] [--dump]\n",
+            argv[0]);
+    return 2;
+  }
+
+  XYSender sender;
+  if (!strcmp(source, "circle")) {
+    sender.path = CirclePath(laps, 1, feed);
+  }
+  else if (!LoadPath(source, sender.path)) {
+    fprintf(stderr, "can't read %s\n", source);
+    return 1;
+  }
+  int fd = OpenPort(port, baud);
+  if (fd < 0) {
+    return 1;
+  }
+
+  printf("%zu waypoints to %s at %ld baud, waiting for the board\n", sender.path.size(), port, baud);
+  uint64_t began = NowUs();
+  uint64_t report = began + 1000000;
+  size_t reported = 0;
+  uint8_t frame[XY_FRAME_MAX];
+  while (!sender.Done()) {
+    pollfd p = {fd, POLLIN, 0};
+    poll(&p, 1, 2);
+    uint8_t bytes[256];
+    ssize_t got;
+    while ((got = read(fd, bytes, sizeof(bytes))) > 0) {
+      uint64_t now = NowUs();
+      for (ssize_t i = 0; i < got; i++) {
+        sender.Receive(bytes[i], now);
+      }
+    }
+
+    size_t length;
+    while ((length = sender.Next(NowUs(), frame)) > 0) {
+      if (write(fd, frame, length) != (ssize_t)length) {
+        fprintf(stderr, "write to %s failed: %s\n", port, strerror(errno));
+        return 1;
+      }
+    }
+
+    uint64_t now = NowUs();
+    if (now >= report) {
+      size_t consumed = sender.Consumed();
+      printf("%6.1f s  %6zu of %zu consumed  %7.1f segments/s  %u rejected  %ld resends\n", (now - began) / 1e6,
+             consumed, sender.path.size(), (consumed - reported) / ((now - report + 1000000) / 1e6), sender.rejected,
+             sender.resends);
+      reported = consumed;
+      report = now + 1000000;
+    }
+    if (!sender.heard && now - began > 10000000) {
+      fprintf(stderr, "no acks from the board in 10 s, is the sketch built without POT_FOLLOW and at %ld baud?\n",
+              baud);
+      return 1;
+    }
+  }
+  printf("done: %zu waypoints, %.1f segments/s sustained, %u rejected, %ld resends\n", sender.path.size(),
+         sender.printRate(), sender.rejected, sender.resends);
+  if (dump && !Dump(fd)) {
+    fprintf(stderr, "no dump from the board in 2 s\n");
+    close(fd);
+    return 1;
+  }
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,178 @@
+// The host end of XYStream.h: keeps the board's waypoint queue full off the credits in its acks
+// Doesn't do any I/O itself. Whatever owns the port hands it every byte that comes back (Receive, which skips the
+// telemetry frames in between), and asks it for the next frame to send (Next) whenever it could write one.
+// XYSend.cpp drives a real serial port with it, and HostSketch drives the sketch running in virtual time.
+//   credit   the board's last ack says it has accepted up to next and has room for free more, so the sender can
+//            have up to next + free waypoints sent. Anything past that waits for the next ack.
+//   resend   if the board hasn't accepted anything new for XY_RESEND_US while some are in flight, a frame got lost
+//            (or the board was reset) and it starts sending again from the board's next
+//   rate     consumed waypoints (accepted and no longer waiting in the board's queue, so turned into motion
+//            segments) over time is the sustained segments/s
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../XYStream.h"
+
+#define XY_RESEND_US 500000
+
+class XYSender {
+  public:
+  std::vector<XYWaypoint> path;
+  size_t sent;        // waypoints sent, numbered like the board numbers them but not wrapping
+  size_t accepted;    // the board's next, unwrapped
+  uint8_t free;       // from the last ack
+  uint8_t rejected;
+  bool heard;         // any ack yet
+  long acks, resends;
+  uint64_t progress;  // when accepted last moved on, us
+  uint64_t first_consumed, last_consumed;  // when the first and the latest waypoint got consumed, us
+
+  XYSender() {
+    this->sent = 0;
+    this->accepted = 0;
+    this->free = 0;
+    this->rejected = 0;
+    this->heard = false;
+    this->acks = 0;
+    this->resends = 0;
+    this->progress = 0;
+    this->first_consumed = 0;
+    this->last_consumed = 0;
+    this->have = 0;
+    this->consumed_seen = 0;
+  }
+
+  // Waypoints the board has taken out of its queue
+  size_t Consumed() {
+    if (!this->heard) {
+      return 0;
+    }
+    size_t waiting = XY_QUEUE_SIZE - 1 - this->free;
+    return this->accepted > waiting ? this->accepted - waiting : 0;
+  }
+
+  bool Done() {
+    return this->heard && Consumed() == this->path.size();
+  }
+
+  // Every byte that came back from the board, now in us
+  void Receive(uint8_t c, uint64_t now) {
+    if (this->have < 2) {
+      uint8_t want = this->have == 0 ? (XY_ACK_SYNC & 0xff) : (XY_ACK_SYNC >> 8);
+      this->have = c == want ? this->have + 1 : c == (XY_ACK_SYNC & 0xff);
+      this->ack[this->have ? this->have - 1 : 0] = c;
+      return;
+    }
+    this->ack[this->have++] = c;
+    if (this->have < sizeof(XYAck)) {
+      return;
+    }
+    this->have = 0;
+    XYAck ack;
+    memcpy(&ack, this->ack, sizeof(ack));
+    if (ack.crc != TelemetryCrc(this->ack, offsetof(XYAck, crc))) {
+      return;
+    }
+    size_t accepted = this->accepted + (uint16_t)(ack.next - (uint16_t)this->accepted);
+    if (accepted != this->accepted || !this->heard) {
+      this->progress = now;
+    }
+    this->accepted = accepted;
+    this->free = ack.free;
+    this->rejected = ack.rejected;
+    this->heard = true;
+    this->acks++;
+    size_t consumed = Consumed();
+    if (consumed > this->consumed_seen) {
+      if (this->consumed_seen == 0) {
+        this->first_consumed = now;
+      }
+      this->last_consumed = now;
+      this->consumed_seen = consumed;
+    }
+  }
+
+  // Writes the next frame into frame (XY_FRAME_MAX bytes) and returns its length, 0 if there's no credit for one
+  size_t Next(uint64_t now, uint8_t* frame) {
+    if (!this->heard) {
+      return 0;  // nothing is known about the board's queue until it has said something
+    }
+    if (this->sent > this->accepted && now - this->progress > XY_RESEND_US) {
+      this->sent = this->accepted;
+      this->progress = now;
+      this->resends++;
+    }
+    if (this->sent < this->accepted) {
+      this->sent = this->accepted;  // the board is ahead of us, e.g. it accepted frames we had given up on
+    }
+    if (this->accepted + this->free <= this->sent || this->sent >= this->path.size()) {
+      return 0;
+    }
+    size_t credit = this->accepted + this->free - this->sent;
+    size_t count = std::min(std::min(credit, (size_t)XY_BATCH), this->path.size() - this->sent);
+    XYHeader header;
+    header.sync = XY_SYNC;
+    header.first = (uint16_t)this->sent;
+    header.count = (uint8_t)count;
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), &this->path[this->sent], count * sizeof(XYWaypoint));
+    size_t length = sizeof(header) + count * sizeof(XYWaypoint);
+    uint16_t crc = TelemetryCrc(frame, length);
+    memcpy(frame + length, &crc, 2);
+    this->sent += count;
+    return length + 2;
+  }
+
+  // Segments/s from the first waypoint consumed to the latest
+  double printRate() {
+    if (this->last_consumed <= this->first_consumed) {
+      return 0;
+    }
+    return (this->consumed_seen - 1) / ((this->last_consumed - this->first_consumed) / 1e6);
+  }
+
+  private:
+  uint8_t ack[sizeof(XYAck)];
+  uint8_t have;
+  size_t consumed_seen;
+};
+
+inline XYWaypoint MakeWaypoint(float x, float y, float feed) {
+  XYWaypoint waypoint;
+  waypoint.x = (int16_t)lroundf(x * 10);
+  waypoint.y = (int16_t)lroundf(y * 10);
+  waypoint.feed = (uint16_t)lroundf(feed);
+  return waypoint;
+}
+
+// laps of a circle through the middle of the workspace, points spacing mm apart
+inline std::vector<XYWaypoint> CirclePath(int laps, float spacing, float feed) {
+  const float cx = 25, cy = 110, r = 35;
+  int points = (int)ceilf(2 * M_PI * r / spacing);
+  std::vector<XYWaypoint> path;
+  for (int i = 0; i <= laps * points; i++) {
+    float a = 2 * M_PI * i / points;
+    path.push_back(MakeWaypoint(cx + r * cosf(a), cy + r * sinf(a), feed));
+  }
+  return path;
+}
+
+// Lines of "x y" or "x y feed" in mm and mm/s, # for comments. False if the file can't be read.
+inline bool LoadPath(const char* file, std::vector<XYWaypoint>& path) {
+  FILE* in = fopen(file, "r");
+  if (!in) {
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    float x, y, feed = 0;
+    if (line[0] != '#' && sscanf(line, "%f %f %f", &x, &y, &feed) >= 2) {
+      path.push_back(MakeWaypoint(x, y, feed));
+    }
+  }
+  fclose(in);
+  return true;
+}